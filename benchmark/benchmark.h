@@ -0,0 +1,144 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_BENCHMARK_BENCHMARK_H
+#define ZFSERVER_BENCHMARK_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+// Minimal microbenchmark harness. A benchmark loops on State::keepRunning();
+// the runner picks the number of iterations to fill the minimum time, repeats
+// the measure, and keeps the median.
+
+namespace zfbench
+{
+	class State final
+	{
+	public:
+		explicit State(uint64_t iterations) noexcept
+			: m_remaining(iterations), m_iterations(iterations)
+		{
+
+		}
+
+		// whether to run another iteration, the clock starts on the first call
+		bool keepRunning() noexcept
+		{
+			if (m_remaining != 0)
+			{
+				if (!m_running && m_remaining == m_iterations)
+					resumeTiming();
+
+				--m_remaining;
+				return true;
+			}
+
+			pauseTiming();
+			return false;
+		}
+
+		// excludes the setup of an iteration from the time
+		void pauseTiming() noexcept
+		{
+			if (m_running)
+			{
+				m_elapsed += std::chrono::steady_clock::now() - m_start;
+				m_running = false;
+			}
+		}
+
+		void resumeTiming() noexcept
+		{
+			if (!m_running)
+			{
+				m_start = std::chrono::steady_clock::now();
+				m_running = true;
+			}
+		}
+
+		// the bytes processed per iteration, for the throughput
+		void setBytesPerIteration(uint64_t bytes) noexcept
+		{
+			m_bytesPerIteration = bytes;
+		}
+
+		// adds to a metric of the benchmark, reported per iteration
+		void addCounter(const std::string& name, double value)
+		{
+			m_counters[name] += value;
+		}
+
+		uint64_t iterations() const noexcept { return m_iterations; }
+		std::chrono::steady_clock::duration elapsed() const noexcept { return m_elapsed; }
+		uint64_t bytesPerIteration() const noexcept { return m_bytesPerIteration; }
+		const std::map<std::string, double>& counters() const noexcept { return m_counters; }
+
+	private:
+		uint64_t m_remaining;
+		uint64_t m_iterations;
+		bool m_running = false;
+		std::chrono::steady_clock::time_point m_start = {};
+		std::chrono::steady_clock::duration m_elapsed = {};
+		uint64_t m_bytesPerIteration = 0;
+		std::map<std::string, double> m_counters = {};
+	};
+
+	using Function = std::function<void(State&)>;
+
+	// registers a benchmark, run in the order of registration
+	void add(std::string name, Function function);
+
+	// register the benchmarks of each area, from main (after the static initialization of the core)
+	void addSecurityBenchmarks();
+	void addNetworkBenchmarks();
+	void addServerBenchmarks();
+
+	// adds a value to the context of the results (e.g. a selected kernel)
+	void addContext(std::string key, std::string value);
+
+	// keeps the value (and its computation) from being optimized out
+	template<typename T>
+	inline void doNotOptimize(const T& value) noexcept
+	{
+		asm volatile("" : : "r,m"(value) : "memory");
+	}
+
+	// forces the pending writes to memory
+	inline void clobberMemory() noexcept
+	{
+		asm volatile("" : : : "memory");
+	}
+}
+
+#endif // ZFSERVER_BENCHMARK_BENCHMARK_H
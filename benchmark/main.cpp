@@ -0,0 +1,272 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <regex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef ZFBENCH_COMMIT
+#   define ZFBENCH_COMMIT "unknown"
+#endif // ZFBENCH_COMMIT
+
+namespace zfbench
+{
+	namespace
+	{
+		struct Benchmark
+		{
+			std::string name;
+			Function function;
+		};
+
+		struct Result
+		{
+			std::string name;
+			uint64_t iterations;
+			double nanoseconds; // per iteration, the median of the repetitions
+			double minNanoseconds;
+			double maxNanoseconds;
+			double bytesPerSecond;
+			std::map<std::string, double> counters; // per iteration, of the median repetition
+		};
+
+		struct Options
+		{
+			std::string filter = ".*";
+			std::string out;
+			double minTime = 0.02; // in seconds, per repetition
+			int repetitions = 5;
+			bool list = false;
+		};
+
+		std::vector<Benchmark>& registry()
+		{
+			static std::vector<Benchmark> benchmarks;
+			return benchmarks;
+		}
+
+		std::vector<std::pair<std::string, std::string>>& context()
+		{
+			static std::vector<std::pair<std::string, std::string>> values;
+			return values;
+		}
+
+		double toNanoseconds(std::chrono::steady_clock::duration duration)
+		{
+			return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+		}
+
+		Result run(const Benchmark& benchmark, const Options& options)
+		{
+			const double minTime = options.minTime * 1e9;
+
+			// grow the iterations until a run fills the minimum time
+			uint64_t iterations = 1;
+			for (;;)
+			{
+				State state(iterations);
+				benchmark.function(state);
+
+				const double elapsed = std::max(toNanoseconds(state.elapsed()), 1.0);
+				if (elapsed >= minTime || iterations >= 1000000000)
+					break;
+
+				const double predicted = static_cast<double>(iterations) * minTime * 1.4 / elapsed;
+				iterations = std::clamp<uint64_t>(static_cast<uint64_t>(predicted), iterations + 1, iterations * 100);
+			}
+
+			std::vector<std::pair<double, State>> runs;
+			for (int i = 0; i < options.repetitions; ++i)
+			{
+				State state(iterations);
+				benchmark.function(state);
+				runs.emplace_back(toNanoseconds(state.elapsed()) / static_cast<double>(iterations), std::move(state));
+			}
+
+			std::sort(runs.begin(), runs.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+			const auto& [nanoseconds, median] = runs[runs.size() / 2];
+
+			Result result = { benchmark.name, iterations, nanoseconds, runs.front().first, runs.back().first, 0.0, {} };
+			if (median.bytesPerIteration() != 0)
+				result.bytesPerSecond = static_cast<double>(median.bytesPerIteration()) * 1e9 / nanoseconds;
+			for (const auto& [name, value] : median.counters())
+				result.counters[name] = value / static_cast<double>(iterations);
+
+			return result;
+		}
+
+		void print(const Result& result)
+		{
+			std::printf("%-56s %12llu %12.1f ns", result.name.c_str(), static_cast<unsigned long long>(result.iterations), result.nanoseconds);
+			if (result.bytesPerSecond != 0.0)
+				std::printf(" %10.1f MiB/s", result.bytesPerSecond / (1024.0 * 1024.0));
+			for (const auto& [name, value] : result.counters)
+				std::printf(" %s=%.1f", name.c_str(), value);
+			std::printf("\n");
+			std::fflush(stdout);
+		}
+
+		// the names and the context values are plain ASCII, only the quotes and backslashes are escaped
+		std::string quote(const std::string& str)
+		{
+			std::string quoted = "\"";
+			for (char c : str)
+			{
+				if (c == '"' || c == '\\')
+					quoted += '\\';
+				quoted += c;
+			}
+			return quoted + "\"";
+		}
+
+		bool write(const char* path, const std::vector<Result>& results, const Options& options)
+		{
+			FILE* file = std::fopen(path, "w");
+			if (file == nullptr)
+				return false;
+
+			char date[32];
+			const std::time_t now = std::time(nullptr);
+			std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+			std::fprintf(file, "{\n  \"context\": {\n");
+			std::fprintf(file, "    \"commit\": %s,\n", quote(ZFBENCH_COMMIT).c_str());
+			std::fprintf(file, "    \"date\": %s,\n", quote(date).c_str());
+			std::fprintf(file, "    \"compiler\": %s,\n", quote(__VERSION__).c_str());
+			std::fprintf(file, "    \"threads\": %u,\n", std::thread::hardware_concurrency());
+			std::fprintf(file, "    \"min_time\": %g,\n", options.minTime);
+			std::fprintf(file, "    \"repetitions\": %d", options.repetitions);
+			for (const auto& [key, value] : context())
+				std::fprintf(file, ",\n    %s: %s", quote(key).c_str(), quote(value).c_str());
+			std::fprintf(file, "\n  },\n  \"benchmarks\": [");
+
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result& result = results[i];
+				std::fprintf(file, "%s\n    {\"name\": %s, \"iterations\": %llu, \"ns_per_iteration\": %.3f, \"min_ns_per_iteration\": %.3f, \"max_ns_per_iteration\": %.3f",
+					i == 0 ? "" : ",", quote(result.name).c_str(), static_cast<unsigned long long>(result.iterations),
+					result.nanoseconds, result.minNanoseconds, result.maxNanoseconds);
+				if (result.bytesPerSecond != 0.0)
+					std::fprintf(file, ", \"bytes_per_second\": %.0f", result.bytesPerSecond);
+				if (!result.counters.empty())
+				{
+					std::fprintf(file, ", \"counters\": {");
+					for (auto it = result.counters.begin(); it != result.counters.end(); ++it)
+						std::fprintf(file, "%s%s: %.3f", it == result.counters.begin() ? "" : ", ", quote(it->first).c_str(), it->second);
+					std::fprintf(file, "}");
+				}
+				std::fprintf(file, "}");
+			}
+
+			std::fprintf(file, "\n  ]\n}\n");
+			const bool written = std::ferror(file) == 0;
+			std::fclose(file);
+			return written;
+		}
+
+		void usage(const char* program)
+		{
+			std::printf("Usage: %s [--filter <regex>] [--out <results.json>] [--min-time <seconds>] [--repetitions <n>] [--list]\n", program);
+		}
+	}
+
+	void add(std::string name, Function function)
+	{
+		registry().push_back({ std::move(name), std::move(function) });
+	}
+
+	void addContext(std::string key, std::string value)
+	{
+		context().emplace_back(std::move(key), std::move(value));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace zfbench;
+
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+			options.filter = argv[++i];
+		else if (std::strcmp(argv[i], "--out") == 0 && hasValue)
+			options.out = argv[++i];
+		else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue)
+			options.minTime = std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue)
+			options.repetitions = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--list") == 0)
+			options.list = true;
+		else
+		{
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	addSecurityBenchmarks();
+	addNetworkBenchmarks();
+	addServerBenchmarks();
+
+	const std::regex filter(options.filter);
+
+	std::vector<Result> results;
+	for (const Benchmark& benchmark : registry())
+	{
+		if (!std::regex_search(benchmark.name, filter))
+			continue;
+
+		if (options.list)
+		{
+			std::printf("%s\n", benchmark.name.c_str());
+			continue;
+		}
+
+		results.push_back(run(benchmark, options));
+		print(results.back());
+	}
+
+	if (!options.out.empty() && !write(options.out.c_str(), results, options))
+	{
+		std::printf("Failed to write '%s'.\n", options.out.c_str());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
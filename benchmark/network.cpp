@@ -0,0 +1,208 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "benchmark.h"
+
+#include "player.h"
+
+#include "network/msg.h"
+#include "network/msgaccount.h"
+#include "network/msgaction.h"
+#include "network/msgconnect.h"
+#include "network/msgitem.h"
+#include "network/msgsink.h"
+#include "network/msgtalk.h"
+#include "network/msguserinfo.h"
+#include "network/msgwalk.h"
+#include "network/stringpacker.h"
+
+#include <cstring>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+using namespace zfserver;
+using namespace zfserver::network;
+
+namespace
+{
+	// the strings of a typical MsgTalk
+	constexpr std::string_view STRINGS[] = { "SYSTEM"sv, "ALLUSERS"sv, ""sv, "ANSWER_OK"sv };
+
+	// serializes in-place in the same buffer, so only the construction is measured
+	class ScratchSink final : public MsgSink
+	{
+	public:
+		uint8_t* reserve(size_t len) override
+		{
+			return len <= sizeof(m_buffer) ? m_buffer : nullptr;
+		}
+
+	private:
+		alignas(64) uint8_t m_buffer[1024] = {};
+	};
+
+	// a frame of the minimum length of the type
+	template<typename T>
+	std::vector<uint8_t> minimalFrame()
+	{
+		std::vector<uint8_t> frame(T::Layout::MIN_LENGTH);
+		Msg::Header header = { static_cast<uint16_t>(frame.size()), T::TYPE };
+		std::memcpy(frame.data(), &header, sizeof(header));
+		return frame;
+	}
+
+	void addCreate(const char* name, std::vector<uint8_t> frame)
+	{
+		auto shared = std::make_shared<std::vector<uint8_t>>(std::move(frame));
+		zfbench::add(std::string("msg/create/") + name, [shared](zfbench::State& state)
+		{
+			while (state.keepRunning())
+			{
+				auto msg = Msg::create(shared->data(), shared->size());
+				zfbench::doNotOptimize(msg);
+			}
+			state.setBytesPerIteration(shared->size());
+		});
+	}
+
+	void addMsgCreate()
+	{
+		// all the handled types, the owning copy of the frame from the pool
+		addCreate("MsgAccount", minimalFrame<MsgAccount>());
+		addCreate("MsgAction", minimalFrame<MsgAction>());
+		addCreate("MsgConnect", minimalFrame<MsgConnect>());
+		addCreate("MsgItem", minimalFrame<MsgItem>());
+		addCreate("MsgWalk", minimalFrame<MsgWalk>());
+
+		const MsgTalk talk(STRINGS[0], STRINGS[1], STRINGS[3], Channel::Entrance);
+		addCreate("MsgTalk", std::vector<uint8_t>(talk.buffer(), talk.buffer() + talk.length()));
+
+		// rejected on the type, without allocation
+		std::vector<uint8_t> unknown(sizeof(Msg::Header));
+		Msg::Header header = { static_cast<uint16_t>(unknown.size()), MSG_NONE };
+		std::memcpy(unknown.data(), &header, sizeof(header));
+		addCreate("unknown", std::move(unknown));
+	}
+
+	void addStringPacker()
+	{
+		zfbench::add("stringpacker/add/strings:4", [](zfbench::State& state)
+		{
+			uint8_t pack[256];
+			while (state.keepRunning())
+			{
+				pack[0] = 0; // an empty pack
+				StringPacker packer(pack, sizeof(pack));
+				for (auto str : STRINGS)
+					packer.addString(str);
+				zfbench::doNotOptimize(pack);
+			}
+		});
+
+		for (uint8_t index : { 0, 3 })
+		{
+			// the strings are walked up to the index
+			zfbench::add("stringpacker/get/index:" + std::to_string(index), [index](zfbench::State& state)
+			{
+				uint8_t pack[256] = {};
+				{
+					StringPacker packer(pack, sizeof(pack));
+					for (auto str : STRINGS)
+						packer.addString(str);
+				}
+
+				while (state.keepRunning())
+				{
+					zfbench::doNotOptimize(pack);
+					const StringPacker packer(pack, sizeof(pack));
+					auto str = packer.getString(index);
+					zfbench::doNotOptimize(str);
+				}
+			});
+		}
+	}
+
+	void addConstruction()
+	{
+		// the owning messages allocate from the pool, the in-place ones write in the sink
+		zfbench::add("msg/construct/MsgTalk/owning", [](zfbench::State& state)
+		{
+			while (state.keepRunning())
+			{
+				MsgTalk msg(STRINGS[0], STRINGS[1], STRINGS[3], Channel::Entrance);
+				zfbench::doNotOptimize(msg);
+			}
+		});
+
+		zfbench::add("msg/construct/MsgTalk/in-place", [](zfbench::State& state)
+		{
+			ScratchSink sink;
+			while (state.keepRunning())
+			{
+				MsgTalk msg(sink, STRINGS[0], STRINGS[1], STRINGS[3], Channel::Entrance);
+				zfbench::doNotOptimize(msg);
+			}
+		});
+
+		zfbench::add("msg/construct/MsgUserInfo/owning", [](zfbench::State& state)
+		{
+			const Player player;
+			while (state.keepRunning())
+			{
+				MsgUserInfo msg(player);
+				zfbench::doNotOptimize(msg);
+			}
+		});
+
+		zfbench::add("msg/construct/MsgUserInfo/in-place", [](zfbench::State& state)
+		{
+			const Player player;
+			ScratchSink sink;
+			while (state.keepRunning())
+			{
+				MsgUserInfo msg(sink, player);
+				zfbench::doNotOptimize(msg);
+			}
+		});
+	}
+}
+
+namespace zfbench
+{
+	void addNetworkBenchmarks()
+	{
+		addMsgCreate();
+		addStringPacker();
+		addConstruction();
+	}
+}
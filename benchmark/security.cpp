@@ -0,0 +1,395 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "benchmark.h"
+
+#include "security/rc5.h"
+#include "security/tqcipher.h"
+#include "security/tqcipher_kernels.h"
+
+#include <cstring>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace zfserver;
+using namespace zfserver::security;
+
+namespace
+{
+	// the sizes of the buffers, from a short message to a full keystream period
+	constexpr size_t SIZES[] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+	// the offsets from a 64-byte boundary: aligned, unaligned, word-aligned and SSE-aligned
+	constexpr size_t OFFSETS[] = { 0, 1, 4, 16 };
+	// the number of sessions flushing on the same tick
+	constexpr size_t BATCH_COUNTS[] = { 1000, 10000 };
+	// the range of the sizes of their messages
+	constexpr size_t BATCH_MIN_SIZE = 20;
+	constexpr size_t BATCH_MAX_SIZE = 100;
+	// the sizes of the RC5 buffers (multiples of the block)
+	constexpr size_t RC5_SIZES[] = { 8, 64, 512, 4096, 65536 };
+	// the number of buffers processed together, e.g. the passwords of a burst of logins
+	constexpr size_t RC5_BUFFER_COUNTS[] = { 1000, 10000 };
+	// the size of these buffers, a password
+	constexpr size_t RC5_BUFFER_SIZE = 16;
+
+	// a buffer starting at the offset from a 64-byte boundary
+	class Buffer final
+	{
+	public:
+		Buffer(size_t len, size_t offset)
+			: m_storage(new uint8_t[len + offset + 64]())
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(m_storage.get());
+			m_data = m_storage.get() + ((64 - address % 64) % 64) + offset;
+		}
+
+		uint8_t* data() noexcept { return m_data; }
+
+	private:
+		std::unique_ptr<uint8_t[]> m_storage;
+		uint8_t* m_data;
+	};
+
+	// random bytes followed by the padding repeating their start, as the kernels expect
+	std::vector<uint8_t> paddedKey(size_t len, std::mt19937& random)
+	{
+		std::vector<uint8_t> key(len + tqcipher::KEY_PADDING);
+		for (size_t i = 0; i != len; ++i)
+			key[i] = static_cast<uint8_t>(random());
+		std::memcpy(key.data() + len, key.data(), tqcipher::KEY_PADDING);
+		return key;
+	}
+
+	std::string suffix(size_t size, size_t offset)
+	{
+		return "/size:" + std::to_string(size) + "/offset:" + std::to_string(offset);
+	}
+
+	void addTqCipherKernels()
+	{
+		auto random = std::make_shared<std::mt19937>(0x5A46);
+		auto key1 = std::make_shared<std::vector<uint8_t>>(paddedKey(tqcipher::PARTIAL_KEY_SIZE, *random));
+		auto key2 = std::make_shared<std::vector<uint8_t>>(paddedKey(tqcipher::PARTIAL_KEY_SIZE, *random));
+		auto stream = std::make_shared<std::vector<uint8_t>>(paddedKey(tqcipher::KEY_STREAM_SIZE, *random));
+
+		// all the kernels, not only the one selected at startup
+		for (const auto& kernel : tqcipher::KERNELS)
+		{
+			if (!kernel.isSupported())
+				continue;
+
+			for (size_t size : SIZES)
+			{
+				for (size_t offset : OFFSETS)
+				{
+					// in-place, with the counter advancing like a stream
+					zfbench::add(std::string("tqcipher/kernel/") + kernel.name + "/partial-keys" + suffix(size, offset), [&kernel, key1, key2, size, offset](zfbench::State& state)
+					{
+						Buffer buffer(size, offset);
+						uint16_t counter = 0;
+						while (state.keepRunning())
+						{
+							kernel.crypt(key1->data(), key2->data(), counter, buffer.data(), buffer.data(), size);
+							counter = static_cast<uint16_t>(counter + size);
+							zfbench::clobberMemory();
+						}
+						state.setBytesPerIteration(size);
+					});
+
+					zfbench::add(std::string("tqcipher/kernel/") + kernel.name + "/keystream" + suffix(size, offset), [&kernel, stream, size, offset](zfbench::State& state)
+					{
+						Buffer buffer(size, offset);
+						uint16_t counter = 0;
+						while (state.keepRunning())
+						{
+							kernel.cryptStream(stream->data(), counter, buffer.data(), buffer.data(), size);
+							counter = static_cast<uint16_t>(counter + size);
+							zfbench::clobberMemory();
+						}
+						state.setBytesPerIteration(size);
+					});
+				}
+			}
+		}
+	}
+
+	void addTqCipher()
+	{
+		// through the public API, with the kernel selected at startup
+		constexpr std::pair<const char*, TqCipher::Mode> MODES[] = {
+			{ "partial-keys", TqCipher::Mode::PartialKeys },
+			{ "keystream", TqCipher::Mode::KeyStream },
+		};
+
+		for (const auto& [modeName, mode] : MODES)
+		{
+			for (size_t size : SIZES)
+			{
+				for (size_t offset : OFFSETS)
+				{
+					zfbench::add(std::string("tqcipher/encrypt/") + modeName + suffix(size, offset), [mode = mode, size, offset](zfbench::State& state)
+					{
+						TqCipher cipher(mode);
+						Buffer buffer(size, offset);
+						while (state.keepRunning())
+						{
+							cipher.encrypt(buffer.data(), size);
+							zfbench::clobberMemory();
+						}
+						state.setBytesPerIteration(size);
+					});
+
+					zfbench::add(std::string("tqcipher/decrypt/") + modeName + suffix(size, offset), [mode = mode, size, offset](zfbench::State& state)
+					{
+						TqCipher cipher(mode);
+						Buffer buffer(size, offset);
+						while (state.keepRunning())
+						{
+							cipher.decrypt(buffer.data(), size);
+							zfbench::clobberMemory();
+						}
+						state.setBytesPerIteration(size);
+					});
+				}
+			}
+		}
+	}
+
+	// a short message per session, each with its own cipher
+	class Batch final
+	{
+	public:
+		explicit Batch(size_t count)
+			: m_ciphers(count)
+		{
+			std::mt19937 random(0x5A46);
+			std::uniform_int_distribution<size_t> sizes(BATCH_MIN_SIZE, BATCH_MAX_SIZE);
+
+			std::vector<size_t> lengths(count);
+			size_t total = 0;
+			for (auto& len : lengths)
+			{
+				len = sizes(random);
+				total += len;
+			}
+
+			m_storage.resize(total);
+			m_items.reserve(count);
+
+			size_t offset = 0;
+			for (size_t i = 0; i != count; ++i)
+			{
+				m_items.push_back({ &m_ciphers[i], m_storage.data() + offset, lengths[i] });
+				offset += lengths[i];
+			}
+		}
+
+		const std::vector<TqCipher::BatchItem>& items() const noexcept { return m_items; }
+		size_t bytes() const noexcept { return m_storage.size(); }
+
+	private:
+		std::vector<TqCipher> m_ciphers;
+		std::vector<uint8_t> m_storage;
+		std::vector<TqCipher::BatchItem> m_items;
+	};
+
+	void addTqCipherBatch()
+	{
+		for (size_t count : BATCH_COUNTS)
+		{
+			const std::string parameters = "/count:" + std::to_string(count);
+
+			zfbench::add("tqcipher/batch" + parameters, [count](zfbench::State& state)
+			{
+				Batch batch(count);
+				while (state.keepRunning())
+				{
+					TqCipher::encryptBatch(batch.items().data(), batch.items().size());
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(batch.bytes());
+			});
+
+			// the same messages, one encrypt call per session
+			zfbench::add("tqcipher/sequential" + parameters, [count](zfbench::State& state)
+			{
+				Batch batch(count);
+				while (state.keepRunning())
+				{
+					for (const auto& item : batch.items())
+						item.cipher->encrypt(item.buf, item.len);
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(batch.bytes());
+			});
+		}
+	}
+
+	void addRC5()
+	{
+		static constexpr uint8_t SEED[RC5::KEY_SIZE] = { 0x3C, 0xDC, 0xFE, 0xE8, 0xC4, 0x54, 0xD6, 0x7E, 0x16, 0xA6, 0xF8, 0x1A, 0xE8, 0xD0, 0x38, 0xBE };
+
+		zfbench::add("rc5/key-setup", [](zfbench::State& state)
+		{
+			uint8_t seed[RC5::KEY_SIZE];
+			std::memcpy(seed, SEED, sizeof(seed));
+
+			RC5 cipher;
+			while (state.keepRunning())
+			{
+				zfbench::doNotOptimize(seed);
+				cipher.generateKey(seed);
+				zfbench::doNotOptimize(cipher);
+			}
+		});
+
+		for (size_t size : RC5_SIZES)
+		{
+			zfbench::add("rc5/encrypt/size:" + std::to_string(size), [size](zfbench::State& state)
+			{
+				const RC5 cipher{ SEED };
+				std::vector<uint8_t> buffer(size);
+				while (state.keepRunning())
+				{
+					cipher.encrypt(buffer.data(), buffer.size());
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(size);
+			});
+
+			zfbench::add("rc5/decrypt/size:" + std::to_string(size), [size](zfbench::State& state)
+			{
+				const RC5 cipher{ SEED };
+				std::vector<uint8_t> buffer(size);
+				while (state.keepRunning())
+				{
+					cipher.decrypt(buffer.data(), buffer.size());
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(size);
+			});
+		}
+
+		// many short buffers, interleaved in the lanes of the kernel
+		for (size_t count : RC5_BUFFER_COUNTS)
+		{
+			const std::string parameters = "/count:" + std::to_string(count) + "/size:" + std::to_string(RC5_BUFFER_SIZE);
+
+			zfbench::add("rc5/encrypt-buffers" + parameters, [count](zfbench::State& state)
+			{
+				const RC5 cipher{ SEED };
+				std::vector<uint8_t> storage(count * RC5_BUFFER_SIZE);
+				std::vector<uint8_t*> buffers(count);
+				for (size_t i = 0; i != count; ++i)
+					buffers[i] = storage.data() + i * RC5_BUFFER_SIZE;
+
+				while (state.keepRunning())
+				{
+					cipher.encrypt(buffers.data(), count, RC5_BUFFER_SIZE);
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(storage.size());
+			});
+
+			zfbench::add("rc5/decrypt-buffers" + parameters, [count](zfbench::State& state)
+			{
+				const RC5 cipher{ SEED };
+				std::vector<uint8_t> storage(count * RC5_BUFFER_SIZE);
+				std::vector<uint8_t*> buffers(count);
+				for (size_t i = 0; i != count; ++i)
+					buffers[i] = storage.data() + i * RC5_BUFFER_SIZE;
+
+				while (state.keepRunning())
+				{
+					cipher.decrypt(buffers.data(), count, RC5_BUFFER_SIZE);
+					zfbench::clobberMemory();
+				}
+				state.setBytesPerIteration(storage.size());
+			});
+		}
+
+		// the kernels only depend on the size of the sub key, not on its value
+		constexpr size_t SUB_SIZE = 2 * RC5::ROUNDS + 2;
+		auto sub = std::make_shared<std::vector<uint32_t>>(SUB_SIZE);
+		std::mt19937 random(0x5A46);
+		for (auto& word : *sub)
+			word = static_cast<uint32_t>(random());
+
+		for (const auto& kernel : rc5::KERNELS)
+		{
+			if (!kernel.isSupported())
+				continue;
+
+			for (size_t size : RC5_SIZES)
+			{
+				if (size / RC5::BLOCK_SIZE < kernel.lanes)
+					continue;
+
+				zfbench::add(std::string("rc5/kernel/") + kernel.name + "/encrypt/size:" + std::to_string(size), [&kernel, sub, size](zfbench::State& state)
+				{
+					std::vector<uint32_t> blocks(size / sizeof(uint32_t));
+					while (state.keepRunning())
+					{
+						kernel.encrypt(sub->data(), RC5::ROUNDS, blocks.data(), size / RC5::BLOCK_SIZE);
+						zfbench::clobberMemory();
+					}
+					state.setBytesPerIteration(size);
+				});
+
+				zfbench::add(std::string("rc5/kernel/") + kernel.name + "/decrypt/size:" + std::to_string(size), [&kernel, sub, size](zfbench::State& state)
+				{
+					std::vector<uint32_t> blocks(size / sizeof(uint32_t));
+					while (state.keepRunning())
+					{
+						kernel.decrypt(sub->data(), RC5::ROUNDS, blocks.data(), size / RC5::BLOCK_SIZE);
+						zfbench::clobberMemory();
+					}
+					state.setBytesPerIteration(size);
+				});
+			}
+		}
+	}
+
+}
+
+namespace zfbench
+{
+	void addSecurityBenchmarks()
+	{
+		addContext("tqcipher_kernel", TqCipher::kernel());
+		addContext("rc5_kernel", rc5::kernel().name);
+
+		addTqCipherKernels();
+		addTqCipher();
+		addTqCipherBatch();
+		addRC5();
+	}
+}
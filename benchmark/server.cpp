@@ -0,0 +1,218 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "benchmark.h"
+
+#include "client.h"
+#include "connection.h"
+#include "player.h"
+#include "serverthread.h"
+
+#include "network/msgaction.h"
+#include "network/msgtalk.h"
+#include "network/msguserinfo.h"
+
+#include "security/tqcipher.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+using namespace zfserver;
+using namespace zfserver::network;
+using namespace zfserver::security;
+
+namespace zfserver
+{
+	// the hooks installed in place of the winsock functions
+	int WINAPI onConnect(SOCKET s, const struct sockaddr_in* name, int namelen);
+	int WINAPI onSend(SOCKET s, const char* buf, int len, int flags);
+	int WINAPI onRecv(SOCKET s, char* buf, int len, int flags);
+}
+
+namespace
+{
+	// a typical recv buffer of the game
+	constexpr int RECV_SIZE = 4096;
+
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedNs(Clock::time_point start) noexcept
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	// encrypts as the game, the inverse of the server-side decryption
+	void encryptAsGame(TqCipher& cipher, const std::vector<uint8_t>& plain, std::vector<uint8_t>& encrypted)
+	{
+		// decrypting 0xAB gives the key at the same counter
+		encrypted.assign(plain.size(), 0xAB);
+		cipher.decrypt(encrypted.data(), encrypted.size());
+
+		for (size_t i = 0; i < plain.size(); ++i)
+		{
+			const uint8_t value = plain[i] ^ encrypted[i];
+			encrypted[i] = static_cast<uint8_t>((value << 4) | (value >> 4)) ^ 0xAB;
+		}
+	}
+
+	void addRecvFrom()
+	{
+		// the game thread flushing a queue of responses, with and without the server thread encrypting them ahead
+		for (size_t depth : { 1, 8, 64, 512 })
+		{
+			for (bool preEncrypted : { false, true })
+			{
+				const std::string name = "connection/recvFrom/depth:" + std::to_string(depth) + (preEncrypted ? "/pre-encrypted" : "/plain");
+				zfbench::add(name, [depth, preEncrypted](zfbench::State& state)
+				{
+					const MsgTalk talk("SYSTEM"sv, "ALLUSERS"sv, "ANSWER_OK"sv, Channel::Entrance);
+					const Player player;
+					const MsgUserInfo info(player);
+
+					Connection connection;
+					connection.connect(ConnectionType::MsgServer, 42);
+
+					char buf[RECV_SIZE];
+					while (state.keepRunning())
+					{
+						state.pauseTiming();
+						{
+							auto lock = connection.lockOutbound();
+							for (size_t i = 0; i < depth; ++i)
+							{
+								if (i % 2 == 0)
+									connection.sendTo(talk);
+								else
+									connection.sendTo(info);
+							}
+
+							if (preEncrypted)
+								connection.preEncrypt();
+						}
+						state.resumeTiming();
+
+						// until the queue is empty
+						while (connection.recvFrom(buf, sizeof(buf), 0) > 0)
+							zfbench::clobberMemory();
+					}
+
+					state.setBytesPerIteration((depth / 2) * info.length() + (depth - depth / 2) * talk.length());
+				});
+			}
+		}
+	}
+
+	// a request sent by the game up to the reception of its response
+	void roundTrip(zfbench::State& state, SOCKET socket)
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(Client::MSGSERVER_PORT);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		onConnect(socket, &address, sizeof(address));
+
+		// a login request, echoed by the server
+		std::vector<uint8_t> frame(MsgAction::Layout::MIN_LENGTH);
+		{
+			Msg::Header header = { static_cast<uint16_t>(frame.size()), MsgAction::TYPE };
+			std::memcpy(frame.data(), &header, sizeof(header));
+
+			auto* info = reinterpret_cast<MsgAction::MsgInfo*>(frame.data());
+			info->Action = MsgAction::Action::GetItems;
+			info->UniqId = Client::instance().player().uid();
+		}
+
+		TqCipher cipher; // the game side of the stream
+		std::vector<uint8_t> encrypted;
+		char buf[RECV_SIZE];
+
+		double gameNs = 0;
+		uint64_t polls = 0;
+		while (state.keepRunning())
+		{
+			state.pauseTiming();
+			encryptAsGame(cipher, frame, encrypted);
+			state.resumeTiming();
+
+			auto start = Clock::now();
+			onSend(socket, reinterpret_cast<const char*>(encrypted.data()), static_cast<int>(encrypted.size()), 0);
+			gameNs += elapsedNs(start);
+
+			// the game polls until the response is there
+			int received = 0;
+			do
+			{
+				start = Clock::now();
+				received = onRecv(socket, buf, sizeof(buf), 0);
+				gameNs += elapsedNs(start);
+				++polls;
+			} while (received <= 0);
+		}
+
+		state.addCounter("game_thread_ns", gameNs);
+		state.addCounter("polls", static_cast<double>(polls));
+	}
+
+	void addRoundTrip()
+	{
+		// the handlers on the game thread, must run first as the server thread can't be stopped
+		zfbench::add("roundtrip/inline", [](zfbench::State& state)
+		{
+			roundTrip(state, 100);
+		});
+
+		zfbench::add("roundtrip/server-thread", [](zfbench::State& state)
+		{
+			static const bool initialized = []
+			{
+				setenv(ServerThread::ENABLE_ENV, "1", 1);
+				Client::instance().initialize();
+				return true;
+			}();
+			(void)initialized;
+
+			roundTrip(state, 101);
+		});
+	}
+}
+
+namespace zfbench
+{
+	void addServerBenchmarks()
+	{
+		addRecvFrom();
+		addRoundTrip();
+	}
+}
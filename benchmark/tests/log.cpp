@@ -0,0 +1,87 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "check.h"
+
+#include "log.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace zfserver;
+
+// The C strings printed with %p are recorded as pointers, without reading the
+// characters (the buffer may not be terminated).
+
+namespace
+{
+	std::string formatted(const char* format, const void* ptr)
+	{
+		char buf[64];
+		std::snprintf(buf, sizeof(buf), format, ptr);
+		return buf;
+	}
+}
+
+int main()
+{
+	// the logger appends, the lines of a previous run must not pass the checks
+	std::remove("./log.txt");
+
+	// not terminated, the characters must not be read
+	const size_t size = 16;
+	std::unique_ptr<char[]> unterminated(new char[size]);
+	std::memset(unterminated.get(), 'x', size);
+
+	char name[] = "player";
+
+	LOG(INFO, "unterminated buffer at %p", unterminated.get());
+	LOG(INFO, "string %s at %p, %d bytes", name, name, static_cast<int>(sizeof(name)));
+	LOG(INFO, "100%% of %s", static_cast<const char*>(name));
+	LOG(INFO, "without arguments");
+	log::flush();
+
+	std::ifstream file("./log.txt");
+	CHECK(file.is_open());
+
+	std::stringstream content;
+	content << file.rdbuf();
+	const std::string text = content.str();
+
+	CHECK(text.find(formatted("unterminated buffer at %p\n", unterminated.get())) != std::string::npos);
+	CHECK(text.find(formatted("string player at %p, 7 bytes\n", name)) != std::string::npos);
+	CHECK(text.find("100% of player\n") != std::string::npos);
+	CHECK(text.find("without arguments\n") != std::string::npos);
+
+	return zftest::result();
+}
@@ -0,0 +1,226 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "check.h"
+
+#include "client.h"
+#include "serverthread.h"
+
+#include "network/msgaction.h"
+#include "network/msgconnect.h"
+
+#include "security/tqcipher.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <thread>
+#include <vector>
+
+using namespace zfserver;
+using namespace zfserver::network;
+using namespace zfserver::security;
+
+namespace zfserver
+{
+	// the hooks installed in place of the winsock functions
+	int WINAPI onConnect(SOCKET s, const struct sockaddr_in* name, int namelen);
+	int WINAPI onSend(SOCKET s, const char* buf, int len, int flags);
+	int WINAPI onRecv(SOCKET s, char* buf, int len, int flags);
+}
+
+// Regression test of the switch to the alternative key: the bytes sent right
+// after MsgConnect must be decrypted with it, even when the handlers run later
+// on the server thread (run with --server-thread).
+
+namespace
+{
+	constexpr int32_t ACCOUNT_UID = 1000001;
+	constexpr int32_t TOKEN = 0x12345678;
+	constexpr int ITERATIONS = 200;
+
+	// the game side of the stream, mirroring the cipher of the server
+	class Game final
+	{
+	public:
+		// encrypts as the game, the inverse of the server-side decryption
+		std::vector<uint8_t> encrypt(const std::vector<uint8_t>& plain)
+		{
+			// decrypting 0xAB gives the key at the same counter
+			std::vector<uint8_t> encrypted(plain.size(), 0xAB);
+			m_cipher.decrypt(encrypted.data(), encrypted.size());
+
+			for (size_t i = 0; i != plain.size(); ++i)
+			{
+				const uint8_t value = plain[i] ^ encrypted[i];
+				encrypted[i] = static_cast<uint8_t>((value << 4) | (value >> 4)) ^ 0xAB;
+			}
+			return encrypted;
+		}
+
+		// decrypts as the game, the inverse of the server-side encryption
+		void decrypt(uint8_t* buf, size_t len)
+		{
+			std::vector<uint8_t> key(len, 0xAB);
+			m_cipher.encrypt(key.data(), key.size());
+
+			for (size_t i = 0; i != len; ++i)
+			{
+				const uint8_t value = buf[i] ^ key[i];
+				buf[i] = static_cast<uint8_t>((value << 4) | (value >> 4)) ^ 0xAB;
+			}
+		}
+
+		void generateAltKey(int32_t a, int32_t b)
+		{
+			m_cipher.generateAltKey(a, b);
+		}
+
+	private:
+		TqCipher m_cipher;
+	};
+
+	template<typename T>
+	std::vector<uint8_t> frame()
+	{
+		std::vector<uint8_t> frame(T::Layout::MIN_LENGTH);
+		Msg::Header header = { static_cast<uint16_t>(frame.size()), T::TYPE };
+		std::memcpy(frame.data(), &header, sizeof(header));
+		return frame;
+	}
+
+	void connect(SOCKET socket)
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(Client::MSGSERVER_PORT);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		CHECK(onConnect(socket, &address, sizeof(address)) == 0);
+	}
+
+	// receives the decrypted frames, until the count is reached (or a timeout)
+	std::vector<std::vector<uint8_t>> receive(SOCKET socket, Game& game, size_t count)
+	{
+		std::vector<uint8_t> received;
+		std::vector<std::vector<uint8_t>> frames;
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (frames.size() < count && std::chrono::steady_clock::now() < deadline)
+		{
+			char buf[4096];
+			const int len = onRecv(socket, buf, sizeof(buf), 0);
+			if (len <= 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			game.decrypt(reinterpret_cast<uint8_t*>(buf), static_cast<size_t>(len));
+			received.insert(received.end(), buf, buf + len);
+
+			Msg::Header header;
+			while (received.size() >= sizeof(header))
+			{
+				std::memcpy(&header, received.data(), sizeof(header));
+				if (header.Length < sizeof(header) || header.Length > received.size())
+					break;
+
+				frames.emplace_back(received.begin(), received.begin() + header.Length);
+				received.erase(received.begin(), received.begin() + header.Length);
+			}
+		}
+
+		return frames;
+	}
+
+	// MsgConnect then a login request with the alternative key, in one send or two
+	void connectThenRequest(SOCKET socket, bool split)
+	{
+		connect(socket);
+
+		auto connectFrame = frame<MsgConnect>();
+		auto* connectInfo = reinterpret_cast<MsgConnect::MsgInfo*>(connectFrame.data());
+		connectInfo->AccountUID = ACCOUNT_UID;
+		connectInfo->Data = TOKEN;
+
+		auto actionFrame = frame<MsgAction>();
+		auto* actionInfo = reinterpret_cast<MsgAction::MsgInfo*>(actionFrame.data());
+		actionInfo->UniqId = Client::instance().player().uid();
+		actionInfo->Action = MsgAction::Action::GetItems;
+
+		Game game;
+		std::vector<uint8_t> sent = game.encrypt(connectFrame);
+		game.generateAltKey(TOKEN, ACCOUNT_UID);
+		const std::vector<uint8_t> request = game.encrypt(actionFrame);
+
+		if (split)
+		{
+			CHECK(onSend(socket, reinterpret_cast<const char*>(sent.data()), static_cast<int>(sent.size()), 0) == static_cast<int>(sent.size()));
+			sent = request;
+		}
+		else
+		{
+			sent.insert(sent.end(), request.begin(), request.end());
+		}
+		CHECK(onSend(socket, reinterpret_cast<const char*>(sent.data()), static_cast<int>(sent.size()), 0) == static_cast<int>(sent.size()));
+
+		// the answers to MsgConnect, then the echo of the request
+		const auto frames = receive(socket, game, 4);
+		CHECK(frames.size() == 4);
+		if (frames.size() != 4)
+			return;
+
+		const uint16_t expected[] = { MSG_TALK, MSG_USERINFO, MSG_TALK, MSG_ACTION };
+		for (size_t i = 0; i != frames.size(); ++i)
+		{
+			Msg::Header header;
+			std::memcpy(&header, frames[i].data(), sizeof(header));
+			CHECK(header.Type == expected[i]);
+		}
+
+		CHECK(frames[3] == actionFrame);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--server-thread") == 0)
+	{
+		setenv(ServerThread::ENABLE_ENV, "1", 1);
+		Client::instance().initialize();
+	}
+
+	for (int i = 0; i != ITERATIONS && zftest::failures() == 0; ++i)
+	{
+		connectThenRequest(42, false);
+		connectThenRequest(42, true);
+	}
+
+	return zftest::result();
+}
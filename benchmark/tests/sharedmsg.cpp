@@ -0,0 +1,148 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "check.h"
+
+#include "connection.h"
+
+#include "network/sharedmsg.h"
+
+#include "security/tqcipher.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace zfserver;
+using namespace zfserver::network;
+using namespace zfserver::security;
+
+// The frames broadcast with a SharedMsg are referenced by the outbound queues
+// until they are flushed, and each connection encrypts them with its own
+// cipher, in the order of the frames copied inline.
+
+namespace
+{
+	constexpr size_t CONNECTION_COUNT = 3;
+	constexpr int CHUNK_SIZE = 7;
+
+	std::vector<uint8_t> frame(size_t len, uint8_t seed)
+	{
+		std::vector<uint8_t> bytes(len);
+		for (size_t i = 0; i != len; ++i)
+			bytes[i] = static_cast<uint8_t>(seed + i * 31);
+		return bytes;
+	}
+
+	void sendInline(Connection& connection, const std::vector<uint8_t>& bytes, std::vector<uint8_t>& expected)
+	{
+		std::memcpy(connection.reserve(bytes.size()), bytes.data(), bytes.size());
+		expected.insert(expected.end(), bytes.begin(), bytes.end());
+	}
+
+	// flushes the queue in small chunks, the reads end in the middle of the frames
+	std::vector<uint8_t> flush(Connection& connection)
+	{
+		std::vector<uint8_t> flushed;
+		char buf[CHUNK_SIZE];
+		for (;;)
+		{
+			const int len = connection.recvFrom(buf, sizeof(buf), 0);
+			if (len <= 0)
+				break;
+
+			flushed.insert(flushed.end(), buf, buf + len);
+		}
+		return flushed;
+	}
+
+	void run(bool preEncrypt)
+	{
+		std::unique_ptr<Connection> connections[CONNECTION_COUNT];
+		std::vector<uint8_t> expected[CONNECTION_COUNT];
+		for (size_t i = 0; i != CONNECTION_COUNT; ++i)
+		{
+			connections[i] = std::make_unique<Connection>();
+			connections[i]->connect(ConnectionType::MsgServer, static_cast<SOCKET>(i + 1));
+		}
+
+		const std::vector<uint8_t> broadcast = frame(45, 0x11);
+		const std::vector<uint8_t> another = frame(12, 0x22);
+		SharedMsg shared(broadcast.data(), broadcast.size());
+		SharedMsg second(another.data(), another.size());
+
+		for (size_t i = 0; i != CONNECTION_COUNT; ++i)
+		{
+			Connection& connection = *connections[i];
+			sendInline(connection, frame(10 + i, static_cast<uint8_t>(i)), expected[i]);
+			connection.sendTo(shared);
+			expected[i].insert(expected[i].end(), broadcast.begin(), broadcast.end());
+			connection.sendTo(second);
+			expected[i].insert(expected[i].end(), another.begin(), another.end());
+			sendInline(connection, frame(20, static_cast<uint8_t>(0x40 + i)), expected[i]);
+			connection.sendTo(shared);
+			expected[i].insert(expected[i].end(), broadcast.begin(), broadcast.end());
+		}
+
+		// referenced by the queues, not copied
+		CHECK(shared.useCount() == 1 + 2 * CONNECTION_COUNT);
+		CHECK(second.useCount() == 1 + CONNECTION_COUNT);
+
+		for (size_t i = 0; i != CONNECTION_COUNT; ++i)
+		{
+			Connection& connection = *connections[i];
+			if (preEncrypt)
+			{
+				auto lock = connection.lockOutbound();
+				connection.preEncrypt();
+			}
+
+			// the game decrypts the stream from the start
+			TqCipher cipher;
+			cipher.encrypt(expected[i].data(), expected[i].size());
+
+			const std::vector<uint8_t> flushed = flush(connection);
+			CHECK(flushed.size() == expected[i].size());
+			CHECK(std::equal(flushed.begin(), flushed.end(), expected[i].begin(), expected[i].end()));
+		}
+
+		// released once flushed (or copied to be pre-encrypted)
+		CHECK(shared.useCount() == 1);
+		CHECK(second.useCount() == 1);
+	}
+}
+
+int main()
+{
+	run(false);
+	run(true);
+
+	return zftest::result();
+}
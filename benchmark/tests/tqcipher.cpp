@@ -0,0 +1,108 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "check.h"
+
+#include "security/tqcipher.h"
+
+#include <random>
+#include <vector>
+
+using namespace zfserver::security;
+
+// TqCipher::encryptBatch must give the same bytes as encrypting each buffer
+// with its own cipher, in the order of the batch.
+
+namespace
+{
+	constexpr size_t CIPHER_COUNT = 64;
+	constexpr size_t ITEM_COUNT = 500;
+
+	struct Item
+	{
+		size_t cipher;
+		std::vector<uint8_t> buffer;
+	};
+
+	void checkBatch(TqCipher::Mode mode, std::mt19937& random)
+	{
+		std::vector<TqCipher> batched;
+		std::vector<TqCipher> expected;
+		for (size_t i = 0; i != CIPHER_COUNT; ++i)
+		{
+			batched.emplace_back(mode);
+			expected.emplace_back(mode);
+
+			// anywhere in the period, including right before its end
+			const size_t skipped = i == 0 ? 0xFFF0 : random() % 0x10000;
+			batched.back().skipEncrypt(skipped);
+			expected.back().skipEncrypt(skipped);
+		}
+
+		// short messages, a few large ones, and ciphers appearing more than once
+		std::vector<Item> items(ITEM_COUNT);
+		for (auto& item : items)
+		{
+			item.cipher = random() % CIPHER_COUNT;
+			item.buffer.resize(random() % 16 == 0 ? 1 + random() % 10000 : random() % 101);
+			for (auto& byte : item.buffer)
+				byte = static_cast<uint8_t>(random());
+		}
+
+		std::vector<TqCipher::BatchItem> batch;
+		for (auto& item : items)
+			batch.push_back({ &batched[item.cipher], item.buffer.data(), item.buffer.size() });
+
+		std::vector<std::vector<uint8_t>> plain;
+		for (const auto& item : items)
+			plain.push_back(item.buffer);
+
+		TqCipher::encryptBatch(batch.data(), batch.size());
+
+		for (size_t i = 0; i != items.size(); ++i)
+		{
+			expected[items[i].cipher].encrypt(plain[i].data(), plain[i].size());
+			CHECK(items[i].buffer == plain[i]);
+		}
+
+		for (size_t i = 0; i != CIPHER_COUNT; ++i)
+			CHECK(batched[i].encryptCounter() == expected[i].encryptCounter());
+	}
+}
+
+int main()
+{
+	std::mt19937 random(0x5A46);
+	for (int i = 0; i != 20; ++i)
+	{
+		checkBatch(TqCipher::Mode::PartialKeys, random);
+		checkBatch(TqCipher::Mode::KeyStream, random);
+	}
+
+	return zftest::result();
+}
@@ -0,0 +1,71 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "hook.h"
+
+// The hooks patch x86 code in the game, they are never installed by the
+// benchmarks. This replaces hook.cpp on POSIX systems.
+
+namespace zfserver
+{
+	Hook::Hook() noexcept
+		: m_originalAddress(nullptr), m_headerSize(0), m_thunkSize(0), m_thunk(nullptr)
+	{
+
+	}
+
+	Hook::~Hook()
+	{
+		reset();
+	}
+
+	void Hook::redirect(LPVOID originalAddress, LPVOID)
+	{
+		m_originalAddress = originalAddress;
+	}
+
+	void Hook::reset() noexcept
+	{
+		m_originalAddress = nullptr;
+	}
+
+	LPVOID Hook::thunk() const noexcept
+	{
+		return m_thunk;
+	}
+
+	int Hook::hookHeaderSize(LPVOID)
+	{
+		return 0;
+	}
+
+	DWORD Hook::relativeAddr32(LPVOID, LPVOID)
+	{
+		return 0;
+	}
+}
@@ -0,0 +1,165 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_BENCHMARK_WIN32_WINDOWS_H
+#define ZFSERVER_BENCHMARK_WIN32_WINDOWS_H
+
+// The subset of the Win32 API used by the portable core, for building the
+// benchmarks on POSIX systems. Only the semantics the core relies on are
+// implemented, the hooking (see hook.cpp) and the crash handling are no-ops.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define WINAPI
+#define APIENTRY
+
+#define TRUE 1
+#define FALSE 0
+
+using BOOL = int;
+using BYTE = unsigned char;
+using PBYTE = BYTE*;
+using LONG = int32_t;
+using DWORD = uint32_t;
+using LPVOID = void*;
+using PVOID = void*;
+using LPCSTR = const char*;
+using HANDLE = void*;
+using HMODULE = void*;
+using FARPROC = void*;
+using SIZE_T = size_t;
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+inline void Sleep(DWORD milliseconds)
+{
+	if (milliseconds == 0)
+		std::this_thread::yield();
+	else
+		std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+inline DWORD GetTickCount()
+{
+	return static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline DWORD GetLastError()
+{
+	return static_cast<DWORD>(errno);
+}
+
+inline DWORD GetCurrentProcessId()
+{
+	return static_cast<DWORD>(getpid());
+}
+
+inline DWORD GetCurrentThreadId()
+{
+	return static_cast<DWORD>(syscall(SYS_gettid));
+}
+
+// the hooks are never installed
+inline HMODULE GetModuleHandleA(LPCSTR)
+{
+	return nullptr;
+}
+
+inline FARPROC GetProcAddress(HMODULE, LPCSTR)
+{
+	return nullptr;
+}
+
+// the unhandled exception filters
+struct EXCEPTION_POINTERS
+{
+	void* ExceptionRecord;
+	void* ContextRecord;
+};
+
+using LPTOP_LEVEL_EXCEPTION_FILTER = LONG (WINAPI*)(EXCEPTION_POINTERS*);
+
+#define EXCEPTION_CONTINUE_SEARCH 0
+
+inline LPTOP_LEVEL_EXCEPTION_FILTER SetUnhandledExceptionFilter(LPTOP_LEVEL_EXCEPTION_FILTER)
+{
+	return nullptr;
+}
+
+// the memory-mapped files, a handle is a file descriptor plus one (0 is null)
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_ALWAYS 2
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PAGE_READWRITE 0x04
+#define FILE_MAP_WRITE 0x2
+
+inline HANDLE CreateFileA(LPCSTR path, DWORD, DWORD, void*, DWORD, DWORD, HANDLE)
+{
+	const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	return fd >= 0 ? reinterpret_cast<HANDLE>(static_cast<intptr_t>(fd) + 1) : INVALID_HANDLE_VALUE;
+}
+
+inline HANDLE CreateFileMappingA(HANDLE file, void*, DWORD, DWORD sizeHigh, DWORD sizeLow, LPCSTR)
+{
+	const int fd = static_cast<int>(reinterpret_cast<intptr_t>(file) - 1);
+	if (ftruncate(fd, static_cast<off_t>((static_cast<uint64_t>(sizeHigh) << 32) | sizeLow)) != 0)
+		return nullptr;
+
+	// the mapping outlives the file handle
+	const int mapping = dup(fd);
+	return mapping >= 0 ? reinterpret_cast<HANDLE>(static_cast<intptr_t>(mapping) + 1) : nullptr;
+}
+
+inline LPVOID MapViewOfFile(HANDLE mapping, DWORD, DWORD, DWORD, SIZE_T size)
+{
+	const int fd = static_cast<int>(reinterpret_cast<intptr_t>(mapping) - 1);
+	void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return view != MAP_FAILED ? view : nullptr;
+}
+
+// a view stays valid once its handles are closed, like on Windows
+inline BOOL CloseHandle(HANDLE handle)
+{
+	return close(static_cast<int>(reinterpret_cast<intptr_t>(handle) - 1)) == 0 ? TRUE : FALSE;
+}
+
+#endif // ZFSERVER_BENCHMARK_WIN32_WINDOWS_H
@@ -0,0 +1,244 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "flightrecorder.h"
+
+#include "network/msgaccount.h"
+#include "network/msgaction.h"
+#include "network/msgconnect.h"
+#include "network/msgconnectex.h"
+#include "network/msgitem.h"
+#include "network/msgtalk.h"
+#include "network/msguserinfo.h"
+#include "network/msgwalk.h"
+#include "network/stringpacker.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace zfserver;
+using namespace zfserver::network;
+
+namespace
+{
+	struct Frame
+	{
+		FlightRecorder::FrameHeader header;
+		std::vector<uint8_t> data;
+	};
+
+	// a fixed-size string of a layout, without its padding
+	std::string_view field(const char* str, size_t size)
+	{
+		return std::string_view(str, strnlen(str, size));
+	}
+
+	template<typename T>
+	const typename T::MsgInfo* layout(const Frame& frame)
+	{
+		return frame.data.size() >= T::Layout::MIN_LENGTH ? reinterpret_cast<const typename T::MsgInfo*>(frame.data.data()) : nullptr;
+	}
+
+	template<typename T>
+	void printStrings(const Frame& frame)
+	{
+		std::vector<uint8_t> pack(frame.data.begin() + T::Layout::STRINGS_OFFSET, frame.data.end());
+		StringPacker packer(pack.data(), pack.size());
+		for (uint8_t i = 0; i != UINT8_MAX; ++i)
+		{
+			auto str = packer.getString(i);
+			if (!str.has_value())
+				break;
+
+			std::printf("  string[%u]=\"%.*s\"\n", i, static_cast<int>(str->size()), str->data());
+		}
+	}
+
+	// prints the fields of the known messages, with their layout
+	const char* decode(const Frame& frame, bool print)
+	{
+		const auto& header = *reinterpret_cast<const Msg::Header*>(frame.data.data());
+		switch (header.Type)
+		{
+		case MsgAccount::TYPE:
+			if (auto info = layout<MsgAccount>(frame); info != nullptr && print)
+			{
+				const auto account = field(info->Account, sizeof(info->Account));
+				const auto server = field(info->Server, sizeof(info->Server));
+				std::printf("  Account=\"%.*s\" Server=\"%.*s\"\n", static_cast<int>(account.size()), account.data(), static_cast<int>(server.size()), server.data());
+			}
+			return "MsgAccount";
+		case MsgConnect::TYPE:
+			if (auto info = layout<MsgConnect>(frame); info != nullptr && print)
+				std::printf("  AccountUID=%d Data=%d\n", info->AccountUID, info->Data);
+			return "MsgConnect";
+		case MsgConnectEx::TYPE:
+			if (auto info = layout<MsgConnectEx>(frame); info != nullptr && print)
+			{
+				const auto address = field(info->Info, sizeof(info->Info));
+				std::printf("  AccountUID=%d Data=%d Info=\"%.*s\" Port=%u\n", info->AccountUID, info->Data, static_cast<int>(address.size()), address.data(), info->Port);
+			}
+			return "MsgConnectEx";
+		case MsgTalk::TYPE:
+			if (auto info = layout<MsgTalk>(frame); info != nullptr && print)
+			{
+				std::printf("  Channel=%u Color=%08X Style=%u Timestamp=%d\n", static_cast<unsigned>(info->Channel), static_cast<unsigned>(info->Color), static_cast<unsigned>(info->Style), info->Timestamp);
+				printStrings<MsgTalk>(frame);
+			}
+			return "MsgTalk";
+		case MsgWalk::TYPE:
+			if (auto info = layout<MsgWalk>(frame); info != nullptr && print)
+				std::printf("  UniqId=%u Direction=%u Mode=%u\n", info->UniqId, info->Direction, info->Mode);
+			return "MsgWalk";
+		case MsgAction::TYPE:
+			if (auto info = layout<MsgAction>(frame); info != nullptr && print)
+				std::printf("  Action=%u UniqId=%u Data=%d Pos=(%u, %u) Direction=%u\n", static_cast<unsigned>(info->Action), info->UniqId, info->Data, info->PosX, info->PosY, info->Direction);
+			return "MsgAction";
+		case MsgItem::TYPE:
+			if (auto info = layout<MsgItem>(frame); info != nullptr && print)
+				std::printf("  Action=%u UniqId=%u Data=%u\n", static_cast<unsigned>(info->Action), info->UniqId, info->Data);
+			return "MsgItem";
+		case MsgUserInfo::TYPE:
+			if (auto info = layout<MsgUserInfo>(frame); info != nullptr && print)
+			{
+				std::printf("  UniqId=%u Look=%u Level=%u Profession=%u Money=%u\n", info->UniqId, info->Look, info->Level, info->Profession, info->Money);
+				printStrings<MsgUserInfo>(frame);
+			}
+			return "MsgUserInfo";
+		default:
+			return "unknown";
+		}
+	}
+
+	void dump(const std::vector<uint8_t>& data)
+	{
+		for (size_t offset = 0; offset < data.size(); offset += 16)
+		{
+			std::printf("  %04zX ", offset);
+			for (size_t i = offset; i != offset + 16; ++i)
+			{
+				if (i < data.size())
+					std::printf(" %02X", data[i]);
+				else
+					std::printf("   ");
+			}
+
+			std::printf("  ");
+			for (size_t i = offset; i < std::min(offset + 16, data.size()); ++i)
+				std::putchar(data[i] >= 0x20 && data[i] < 0x7F ? data[i] : '.');
+			std::putchar('\n');
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::printf("Usage: %s <flight_*.zffr> [--hex]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const bool hex = argc >= 3 && std::strcmp(argv[2], "--hex") == 0;
+
+	FILE* file = std::fopen(argv[1], "rb");
+	if (file == nullptr)
+	{
+		std::printf("Failed to open '%s'.\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	FlightRecorder::FileHeader header = {};
+	if (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != FlightRecorder::FILE_MAGIC || header.version != FlightRecorder::FILE_VERSION)
+	{
+		std::printf("'%s' is not a flight recorder dump (version %u).\n", argv[1], FlightRecorder::FILE_VERSION);
+		std::fclose(file);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Frame> frames(header.count);
+	for (auto& frame : frames)
+	{
+		if (std::fread(&frame.header, sizeof(frame.header), 1, file) != 1)
+		{
+			std::printf("Truncated dump, %zu frames read.\n", static_cast<size_t>(&frame - frames.data()));
+			frames.resize(&frame - frames.data());
+			break;
+		}
+
+		frame.data.resize(frame.header.recorded);
+		if (std::fread(frame.data.data(), 1, frame.data.size(), file) != frame.data.size())
+		{
+			std::printf("Truncated dump, %zu frames read.\n", static_cast<size_t>(&frame - frames.data()));
+			frames.resize(&frame - frames.data());
+			break;
+		}
+	}
+	std::fclose(file);
+
+	// the directions are recorded apart, merged on their timestamps
+	std::stable_sort(frames.begin(), frames.end(), [](const Frame& lhs, const Frame& rhs)
+	{
+		return lhs.header.timestamp < rhs.header.timestamp;
+	});
+
+	std::printf("Connection type %d, %zu frames\n", header.connectionType, frames.size());
+
+	const int64_t start = frames.empty() ? 0 : frames.front().header.timestamp;
+	for (const auto& frame : frames)
+	{
+		const bool inbound = frame.header.direction == FlightRecorder::Direction::Inbound;
+		const bool complete = frame.data.size() >= sizeof(Msg::Header);
+		const uint16_t type = complete ? reinterpret_cast<const Msg::Header*>(frame.data.data())->Type : 0;
+
+		std::printf("[+%10.6f] %s #%llu counter=%04X %s (%u) len=%u%s\n",
+			static_cast<double>(frame.header.timestamp - start) / 1e6,
+			inbound ? "game->server" : "server->game",
+			static_cast<unsigned long long>(frame.header.sequence),
+			frame.header.counter,
+			complete ? decode(frame, false) : "truncated",
+			type,
+			frame.header.length,
+			frame.header.recorded != frame.header.length ? " (truncated)" : "");
+
+		// the decoded fields are only read within the recorded bytes
+		if (complete && frame.header.recorded == frame.header.length)
+			decode(frame, true);
+
+		if (hex)
+			dump(frame.data);
+	}
+
+	return EXIT_SUCCESS;
+}
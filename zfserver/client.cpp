@@ -29,9 +29,14 @@
 #include "client.h"
 
 #include "log.h"
+#include "stats.h"
+#include "trace.h"
 #include "network/msg.h"
+#include "network/msgconnect.h"
+
+#include <cstdio>
+#include <ctime>
 
-#include <cassert>
 #include <algorithm>
 
  // ensure we link ws2_32 (even if not specified in the link flags)
@@ -45,6 +50,9 @@ namespace zfserver
 	int WINAPI onRecv(SOCKET s, char* buf, int len, int flags);
 	int WINAPI onClose(SOCKET s);
 	int WINAPI onGetLastError();
+	LONG WINAPI onCrash(EXCEPTION_POINTERS* info);
+
+	LPTOP_LEVEL_EXCEPTION_FILTER g_previousCrashFilter = nullptr;
 
 	std::atomic<Client*> Client::s_instance = { nullptr };
 
@@ -72,11 +80,26 @@ namespace zfserver
 	{
 		LOG(VRB, "Initializing...");
 
-		m_connectHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "connect"), &onConnect);
-		m_sendHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "send"), &onSend);
-		m_recvHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "recv"), &onRecv);
-		m_closeHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "closesocket"), &onClose);
-		m_lastErrorHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "WSAGetLastError"), &onGetLastError);
+		stats::initialize();
+		trace::initialize();
+
+		m_connectHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "connect"), reinterpret_cast<LPVOID>(&onConnect));
+		m_sendHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "send"), reinterpret_cast<LPVOID>(&onSend));
+		m_recvHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "recv"), reinterpret_cast<LPVOID>(&onRecv));
+		m_closeHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "closesocket"), reinterpret_cast<LPVOID>(&onClose));
+		m_lastErrorHook.redirect(GetProcAddress(GetModuleHandleA("ws2_32.dll"), "WSAGetLastError"), reinterpret_cast<LPVOID>(&onGetLastError));
+
+		g_previousCrashFilter = SetUnhandledExceptionFilter(&onCrash);
+
+		if (ServerThread::isEnabled())
+		{
+			LOG(VRB, "Running the handlers on the server thread...");
+			m_serverThread = std::make_unique<ServerThread>(*this);
+
+			m_preEncrypt = ServerThread::isPreEncryptEnabled();
+			if (m_preEncrypt)
+				LOG(VRB, "Pre-encrypting the responses on the server thread...");
+		}
 
 		LOG(VRB, "Initialization done... Hooked networking functions...");
 	}
@@ -91,6 +114,20 @@ namespace zfserver
 		return m_player;
 	}
 
+	void Client::dumpFlightRecorders() noexcept
+	{
+		const long long now = static_cast<long long>(std::time(nullptr));
+		for (const auto& connection : m_connections)
+		{
+			const int type = static_cast<int>(connection.type());
+
+			char path[64];
+			std::snprintf(path, sizeof(path), "./flight_%d_%lld.zffr", type, now);
+			if (connection.recorder().dump(path, type))
+				LOG(INFO, "Flight recorder dumped in %s", path);
+		}
+	}
+
 	Connection* Client::findConnection(SOCKET socket) noexcept
 	{
 		auto connectionIt = std::find_if(std::begin(m_connections), std::end(m_connections), [socket](const auto& connection) { return connection.socket() == socket; });
@@ -103,31 +140,57 @@ namespace zfserver
 		m_connections[index].connect(connectionType, socket);
 	}
 
-	int Client::processOutgoing(Connection& connection, const char* buf, int len, int flags)
+	int Client::processOutgoing(Connection& connection, const char* buf, int len, int)
 	{
-		auto& cipher = connection.cipher();
+		stats::ScopedTimer timer(stats::latency(stats::Probe::ProcessOutgoing));
+		trace::ScopedSpan span("send", "bytes", static_cast<uint32_t>(len));
 
-		uint8_t data[4192]; // should be large enough for Conquer Online 2.0
-		std::memcpy(data, buf, len); // we could modify buf directly, but that would violate the send contract
+		auto& inbound = connection.inbound();
 
-		cipher.decrypt(data, len);
+		// we could decrypt buf directly, but that would violate the send contract
+		inbound.feed(connection.cipher(), reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(len), [&connection](const uint8_t* frame, size_t length)
+		{
+			// the bytes after MsgConnect use the alternative key, which can't wait for the handler
+			const auto& header = *reinterpret_cast<const network::Msg::Header*>(frame);
+			if (header.Type == network::MsgConnect::TYPE)
+				network::MsgConnect::generateAltKey(connection, frame, length);
+		});
+
+		// the complete frames are dispatched in a batch, the partial ones wait for the next send
+		inbound.drain([this, &connection](uint8_t* frames, size_t length)
+		{
+			connection.recordInbound(frames, length);
+
+			if (m_serverThread != nullptr)
+				m_serverThread->post(connection, frames, length);
+			else
+				dispatch(connection, frames, length);
+		});
+
+		return len; // fully processed
+	}
+
+	void Client::dispatch(Connection& connection, uint8_t* frames, size_t len)
+	{
+		trace::ScopedSpan span("dispatch", "bytes", static_cast<uint32_t>(len));
+
+		// the responses are queued as a whole, the game's recv can't see them half-written
+		auto lock = connection.lockOutbound();
 
 		uint16_t length = 0;
-		for (int offset = 0; offset < len; offset += length)
+		for (size_t offset = 0; offset < len; offset += length)
 		{
-			network::Msg::Header& header = *(network::Msg::Header*)(data + offset);
-			LOG(DBG, "Client sent %u (%u) on socket %u", header.Type, header.Length, socket);
+			const network::Msg::Header& header = *reinterpret_cast<const network::Msg::Header*>(frames + offset);
+			LOG(DBG, "Client sent %u (%u) on socket %u", header.Type, header.Length, connection.socket());
 
+			// handlers work on a view of the decrypted data, and copy what they echo
 			length = header.Length;
-			assert(offset + length <= len);
-
-			auto msg = network::Msg::create(data + offset, header.Length);
-			assert(msg != nullptr);
-
-			msg->process(*this, connection);
+			network::Msg::dispatch(frames + offset, length, *this, connection);
 		}
 
-		return len; // fully processed
+		// the game's recv is then a plain copy
+		if (m_preEncrypt)
+			connection.preEncrypt();
 	}
 
 	int Client::processIncoming(Connection& connection, char* buf, int len, int flags)
@@ -286,6 +349,18 @@ namespace zfserver
 		}
 	}
 
+	LONG WINAPI onCrash(EXCEPTION_POINTERS* info)
+	{
+		static Client& client = Client::instance();
+
+		if constexpr (FlightRecorder::ENABLED)
+			client.dumpFlightRecorders();
+
+		// the last records are still in the rings of the threads
+		log::flush();
+		return g_previousCrashFilter != nullptr ? g_previousCrashFilter(info) : EXCEPTION_CONTINUE_SEARCH;
+	}
+
 	int WINAPI onGetLastError()
 	{
 		static Client& client = Client::instance();
@@ -32,12 +32,14 @@
 #include "connection.h"
 #include "hook.h"
 #include "player.h"
+#include "serverthread.h"
 
 #include <windows.h>
 #include <winsock2.h>
 
 #include <cstdint>
 #include <atomic>
+#include <memory>
 
 namespace zfserver
 {
@@ -71,12 +73,16 @@ namespace zfserver
 
 		Player& player() noexcept;
 
+		// writes the flight recorders of the connections (if compiled in)
+		void dumpFlightRecorders() noexcept;
+
 	private:
 		friend int WINAPI onConnect(SOCKET s, const struct sockaddr_in* name, int namelen);
 		friend int WINAPI onSend(SOCKET s, const char* buf, int len, int flags);
 		friend int WINAPI onRecv(SOCKET s, char* buf, int len, int flags);
 		friend int WINAPI onClose(SOCKET s);
 		friend int WINAPI onGetLastError();
+		friend class ServerThread;
 
 		Connection* findConnection(SOCKET socket) noexcept;
 
@@ -84,6 +90,9 @@ namespace zfserver
 		int processOutgoing(Connection& connection, const char* buf, int len, int flags);
 		int processIncoming(Connection& connection, char* buf, int len, int flags);
 
+		// runs the handlers of the complete frames
+		void dispatch(Connection& connection, uint8_t* frames, size_t len);
+
 		int realConnect(SOCKET s, const struct sockaddr_in* name, int namelen);
 		int realSend(SOCKET s, const char* buf, int len, int flags);
 		int realRecv(SOCKET s, char* buf, int len, int flags);
@@ -104,6 +113,9 @@ namespace zfserver
 
 		Connection m_connections[2] = {};
 		Player m_player = {}; // create a default dummy player for now...
+
+		std::unique_ptr<ServerThread> m_serverThread = nullptr; // never destroyed, like the client
+		bool m_preEncrypt = false; // whether the server thread also encrypts the responses
 	};
 }
 
@@ -29,9 +29,20 @@
 #include "connection.h"
 #include "client.h"
 
+#include "log.h"
+#include "stats.h"
+#include "trace.h"
 #include "network/msg.h"
+#include "network/msgpool.h"
 
-#include <numeric>
+#include "security/parallelencryptor.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 
 namespace zfserver
 {
@@ -50,33 +61,89 @@ namespace zfserver
 		return m_cipher;
 	}
 
+	FrameDecoder& Connection::inbound() noexcept
+	{
+		return m_inbound;
+	}
+
+	const FlightRecorder& Connection::recorder() const noexcept
+	{
+		return m_recorder;
+	}
+
 	void Connection::connect(ConnectionType type, SOCKET socket) noexcept
 	{
+		// the server thread may still be queuing bytes for the previous connection
+		auto lock = lockOutbound();
+
 		m_type = type;
 		m_socket = socket;
 		m_cipher = {}; // reset the cipher
+		m_inbound.clear();
+		m_outbound.clear();
+		m_shared.clear();
+		m_flushedInline = 0;
+		m_sharedOffset = 0;
+		m_sharedSize = 0;
+		m_encrypted = 0;
+		m_stats = {};
 	}
 
 	void Connection::sendTo(network::Msg&& msg)
 	{
-		m_messages.push_back(std::make_unique<network::Msg>(std::move(msg)));
+		sendTo(static_cast<const network::Msg&>(msg));
 	}
 
 	void Connection::sendTo(const network::Msg& msg)
 	{
-		m_messages.push_back(std::make_unique<network::Msg>(msg));
+		uint8_t* frame = reserve(msg.length());
+		std::memcpy(frame, msg.buffer(), msg.length());
+		recordOutbound(frame, msg.length());
 	}
 
 	void Connection::sendTo(std::unique_ptr<network::Msg> msg)
 	{
-		m_messages.push_back(std::move(msg));
+		assert(msg != nullptr);
+		sendTo(*msg);
+	}
+
+	void Connection::sendTo(network::SharedMsg msg)
+	{
+		assert(msg);
+
+		// the frame is only copied by recvFrom, encrypted with the cipher of the connection
+		const size_t len = msg.length();
+		m_shared.push_back({ m_flushedInline + m_outbound.size(), len, std::move(msg), {} });
+		m_sharedSize += len;
+
+		recordOutbound(m_shared.back().msg.buffer(), len);
+	}
+
+	uint8_t* Connection::reserve(size_t len)
+	{
+		return m_outbound.reserve(len);
+	}
+
+	std::unique_lock<std::mutex> Connection::lockOutbound()
+	{
+		return std::unique_lock<std::mutex>(m_outboundMutex);
 	}
 
 	int Connection::recvFrom(char* buf, int len, int flags)
 	{
+		stats::ScopedTimer timer(stats::latency(stats::Probe::RecvFrom));
+
+		// never wait on the handlers, the game polls again on its next frame
+		std::unique_lock<std::mutex> lock(m_outboundMutex, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			winsock::setLastError(WSAEWOULDBLOCK);
+			return SOCKET_ERROR;
+		}
+
 		if (flags == MSG_PEEK)
 		{
-			int available = std::accumulate(m_messages.cbegin(), m_messages.cend(), 0, [](int available, const auto& msg) { return available + msg->length(); });
+			int available = static_cast<int>(queued());
 
 			// cannot return 0 - in TCP, it means the remote has gracefully closed the connection
 			if (available == 0)
@@ -88,39 +155,214 @@ namespace zfserver
 			return available;
 		}
 
-		int receivedLength = 0;
+		// stream semantics, like a TCP socket: fill the buffer, and the rest of
+		// a split message stays at the head of the ring for the next call
+		const size_t receivedLength = std::min(queued(), static_cast<size_t>(std::max(len, 0)));
 
-		size_t length = 0;
-		for (int offset = 0; !m_messages.empty() && offset < len; offset += length)
+		// cannot return 0 - in TCP, it means the remote has gracefully closed the connection
+		if (receivedLength == 0)
 		{
-			auto& msg = m_messages.front();
-			length = msg->length();
+			winsock::setLastError(WSAEWOULDBLOCK);
+			return SOCKET_ERROR;
+		}
 
-			// check if next message can fit
-			if (offset + length >= len)
-				break;
+		trace::ScopedSpan span("recv", "bytes", static_cast<uint32_t>(receivedLength));
+		const auto start = std::chrono::steady_clock::now();
 
-			std::memcpy(buf + offset, msg->buffer(), msg->length());
-			receivedLength += length;
+		uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
 
-			m_messages.pop_front();
-		}
-
-		m_cipher.encrypt(reinterpret_cast<uint8_t*>(buf), receivedLength);
+		// pre-encrypted on the server thread, only a copy is left
+		const size_t preEncrypted = std::min(m_encrypted, receivedLength);
+		forEachPiece(0, preEncrypted, [&dst](const Piece& piece)
+		{
+			std::memcpy(dst, source(piece), piece.len);
+			dst += piece.len;
+		});
 
-		// cannot return 0 - in TCP, it means the remote has gracefully closed the connection
-		if (receivedLength == 0)
+		if (preEncrypted != receivedLength)
 		{
-			winsock::setLastError(WSAEWOULDBLOCK);
-			return SOCKET_ERROR;
+			// copy and encrypt the rest in a single pass (split on the workers for large bursts)
+			stats::ScopedTimer encryptTimer(stats::latency(stats::Probe::Encrypt));
+
+			security::ParallelEncryptor::Span spans[8];
+			size_t count = 0;
+			forEachPiece(preEncrypted, receivedLength - preEncrypted, [&](const Piece& piece)
+			{
+				if (count == std::size(spans))
+				{
+					security::ParallelEncryptor::instance().encrypt(m_cipher, spans, count);
+					count = 0;
+				}
+
+				spans[count++] = { source(piece), dst, piece.len };
+				dst += piece.len;
+			});
+			security::ParallelEncryptor::instance().encrypt(m_cipher, spans, count);
 		}
 
-		return receivedLength;
+		m_encrypted -= preEncrypted;
+		m_stats.preEncryptedBytes += preEncrypted;
+
+		consumeQueued(receivedLength);
+
+		m_stats.bytes += receivedLength;
+		m_stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		return static_cast<int>(receivedLength);
+	}
+
+	void Connection::preEncrypt() noexcept
+	{
+		encryptQueued(queued());
 	}
 
 	void Connection::disconnect() noexcept
 	{
+		LOG(DBG, "Flushed %llu bytes (%llu pre-encrypted) in %llu us on the game thread",
+			m_stats.bytes, m_stats.preEncryptedBytes, m_stats.nanoseconds / 1000);
+
+		// the pool is shared by all the connections, to tune its size classes
+		for (const auto& pool : network::MsgPool::instance().stats())
+		{
+			if (pool.size != 0)
+				LOG(DBG, "MsgPool[%zu]: %llu hits, %llu misses, %zu in use (high-water %zu)", pool.size, pool.hits, pool.misses, pool.inUse, pool.highWater);
+			else
+				LOG(DBG, "MsgPool[heap]: %llu allocations, %zu in use (high-water %zu)", pool.misses, pool.inUse, pool.highWater);
+		}
+
 		m_type = ConnectionType::Unknown;
 		m_socket = INVALID_SOCKET;
 	}
+
+	void Connection::recordFrames(const uint8_t* frames, size_t len) noexcept
+	{
+		// the frames are at the front of the decrypted bytes
+		uint16_t counter = static_cast<uint16_t>(m_cipher.decryptCounter() - m_inbound.pending());
+
+		uint16_t length = 0;
+		for (size_t offset = 0; offset < len; offset += length)
+		{
+			std::memcpy(&length, frames + offset, sizeof(length));
+			m_recorder.record(FlightRecorder::Direction::Inbound, counter, frames + offset, length);
+			counter = static_cast<uint16_t>(counter + length);
+		}
+	}
+
+	size_t Connection::queued() const noexcept
+	{
+		return m_outbound.size() + m_sharedSize;
+	}
+
+	const uint8_t* Connection::source(const Piece& piece) noexcept
+	{
+		if (piece.frame == nullptr)
+			return piece.inlined;
+
+		const SharedFrame& frame = *piece.frame;
+		return (frame.encrypted != nullptr ? frame.encrypted.get() : frame.msg.buffer()) + piece.offset;
+	}
+
+	template<typename F>
+	void Connection::forEachPiece(size_t offset, size_t len, F&& f)
+	{
+		const size_t end = offset + len;
+		size_t position = 0; // in the queued bytes
+		size_t inlined = 0; // the bytes of the ring before the position
+
+		// the bytes of the ring up to the position, in up to two regions
+		const auto visitRing = [&](size_t next)
+		{
+			const size_t first = std::max(offset, position);
+			const size_t last = std::min(end, position + (next - inlined));
+			if (first < last)
+			{
+				auto regions = m_outbound.regions(inlined + (first - position), last - first);
+				f(Piece{ regions.first, nullptr, 0, regions.firstLength });
+				if (regions.secondLength != 0)
+					f(Piece{ regions.second, nullptr, 0, regions.secondLength });
+			}
+
+			position += next - inlined;
+			inlined = next;
+		};
+
+		for (size_t i = 0; i != m_shared.size() && position < end; ++i)
+		{
+			SharedFrame& frame = m_shared[i];
+			visitRing(static_cast<size_t>(frame.position - m_flushedInline));
+
+			const size_t flushed = i == 0 ? m_sharedOffset : 0;
+			const size_t first = std::max(offset, position);
+			const size_t last = std::min(end, position + (frame.length - flushed));
+			if (first < last)
+				f(Piece{ nullptr, &frame, flushed + (first - position), last - first });
+
+			position += frame.length - flushed;
+		}
+
+		if (position < end)
+			visitRing(m_outbound.size());
+	}
+
+	void Connection::consumeQueued(size_t len) noexcept
+	{
+		assert(len <= queued());
+
+		while (len != 0)
+		{
+			// the bytes of the ring before the next shared frame
+			const size_t inlined = m_shared.empty() ? m_outbound.size() : static_cast<size_t>(m_shared.front().position - m_flushedInline);
+			const size_t n = std::min(len, inlined);
+			m_outbound.consume(n);
+			m_flushedInline += n;
+			len -= n;
+
+			if (len == 0)
+				break;
+
+			// the last reference of the connection is released once the frame is flushed
+			SharedFrame& frame = m_shared.front();
+			const size_t flushed = std::min(len, frame.length - m_sharedOffset);
+			m_sharedOffset += flushed;
+			m_sharedSize -= flushed;
+			len -= flushed;
+
+			if (m_sharedOffset == frame.length)
+			{
+				m_shared.pop_front();
+				m_sharedOffset = 0;
+			}
+		}
+	}
+
+	void Connection::encryptQueued(size_t len) noexcept
+	{
+		if (m_encrypted >= len)
+			return;
+
+		stats::ScopedTimer timer(stats::latency(stats::Probe::Encrypt));
+
+		// in-place, the bytes are encrypted in the order of the stream
+		forEachPiece(m_encrypted, len - m_encrypted, [this](const Piece& piece)
+		{
+			if (piece.frame == nullptr)
+			{
+				m_cipher.encrypt(piece.inlined, piece.len);
+				return;
+			}
+
+			// the ciphertext is specific to the connection, the shared frame is copied
+			SharedFrame& frame = *piece.frame;
+			if (frame.encrypted == nullptr)
+			{
+				frame.encrypted = network::MsgPool::instance().allocate(frame.length);
+				std::memcpy(frame.encrypted.get(), frame.msg.buffer(), frame.length);
+				frame.msg = {};
+			}
+
+			m_cipher.encrypt(frame.encrypted.get() + piece.offset, piece.len);
+		});
+
+		m_encrypted = len;
+	}
 }
\ No newline at end of file
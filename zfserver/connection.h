@@ -29,10 +29,23 @@
 #ifndef ZFSERVER_CONNECTION_H
 #define ZFSERVER_CONNECTION_H
 
+#include "flightrecorder.h"
+#include "framedecoder.h"
+#include "ringbuffer.h"
+#include "stats.h"
+
+#include "network/msgpool.h"
+#include "network/msgsink.h"
+#include "network/sharedmsg.h"
+
 #include "security/tqcipher.h"
 
+#include <cstring>
+
 #include <deque>
 #include <memory>
+#include <mutex>
+#include <utility>
 
 #include <winsock2.h>
 
@@ -50,7 +63,7 @@ namespace zfserver
 		MsgServer = 1,
 	};
 
-	class Connection final
+	class Connection final : public network::MsgSink
 	{
 	public:
 		Connection() = default;
@@ -59,22 +72,118 @@ namespace zfserver
 		ConnectionType type() const noexcept;
 		SOCKET socket() const noexcept;
 		security::TqCipher& cipher() noexcept;
+		FrameDecoder& inbound() noexcept;
+		const FlightRecorder& recorder() const noexcept;
 
 		void connect(ConnectionType type, SOCKET socket) noexcept;
 
+		// copies the frame at the end of the outbound queue
 		void sendTo(network::Msg&& msg);
 		void sendTo(const network::Msg& msg);
 		void sendTo(std::unique_ptr<network::Msg> msg);
 
+		// references the frame, serialized once for the broadcasts, until it is flushed
+		void sendTo(network::SharedMsg msg);
+
+		// serializes the message in-place at the end of the outbound queue
+		template<typename T, typename... Args>
+		void emplace(Args&&... args)
+		{
+			T msg(*this, std::forward<Args>(args)...);
+			recordOutbound(msg.buffer(), msg.length());
+		}
+
+		uint8_t* reserve(size_t len) override;
+
+		// records the complete frames sent by the game, before their dispatch
+		void recordInbound(const uint8_t* frames, size_t len) noexcept
+		{
+			if constexpr (FlightRecorder::ENABLED)
+				recordFrames(frames, len);
+		}
+
+		// held while the handlers queue messages (possibly on the server thread)
+		[[nodiscard]] std::unique_lock<std::mutex> lockOutbound();
+
+		// encrypts the queued bytes ahead of recvFrom, which then only copies them (with the outbound lock held)
+		void preEncrypt() noexcept;
+
 		int recvFrom(char* buf, int len, int flags);
 		
 		void disconnect() noexcept;
 
+	private:
+		// the work done by recvFrom on the game thread, logged on disconnect
+		struct Stats
+		{
+			uint64_t bytes; // flushed to the game
+			uint64_t preEncryptedBytes; // flushed with a plain copy
+			uint64_t nanoseconds; // spent copying (and encrypting)
+		};
+
+		// a shared frame, queued between the bytes of the ring
+		struct SharedFrame
+		{
+			uint64_t position; // the bytes queued in the ring before it, since the connection
+			size_t length;
+			network::SharedMsg msg;
+			network::MsgPool::Buffer encrypted; // its own copy, once pre-encrypted
+		};
+
+		// a contiguous part of the queued bytes
+		struct Piece
+		{
+			uint8_t* inlined; // in the ring, or nullptr
+			SharedFrame* frame; // or in a shared frame
+			size_t offset; // in the shared frame
+			size_t len;
+		};
+
+		// the number of queued bytes, in the ring and in the shared frames
+		size_t queued() const noexcept;
+
+		// the first byte of the piece
+		static const uint8_t* source(const Piece& piece) noexcept;
+
+		// calls f for the pieces of len queued bytes starting at offset, in the order of the stream
+		template<typename F>
+		void forEachPiece(size_t offset, size_t len, F&& f);
+
+		// drops the first len queued bytes
+		void consumeQueued(size_t len) noexcept;
+
+		// encrypts in-place the first len queued bytes, if not already done
+		void encryptQueued(size_t len) noexcept;
+
+		// records the frame just queued
+		void recordOutbound(const uint8_t* frame, size_t len) noexcept
+		{
+			// the type follows the length in the header
+			uint16_t type = 0;
+			std::memcpy(&type, frame + sizeof(uint16_t), sizeof(type));
+			stats::count(stats::Direction::Sent, type, len);
+
+			// the queued bytes not yet encrypted are ahead in the stream
+			if constexpr (FlightRecorder::ENABLED)
+				m_recorder.record(FlightRecorder::Direction::Outbound, static_cast<uint16_t>(m_cipher.encryptCounter() + (queued() - m_encrypted - len)), frame, len);
+		}
+
+		void recordFrames(const uint8_t* frames, size_t len) noexcept;
+
 	private:
 		ConnectionType m_type = ConnectionType::Unknown;
 		SOCKET m_socket = INVALID_SOCKET;
 		security::TqCipher m_cipher = {};
-		std::deque<std::unique_ptr<network::Msg>> m_messages = {};
+		FrameDecoder m_inbound = {}; // the partial frames sent by the game
+		RingBuffer m_outbound = {}; // the framed messages, encrypted when flushed by recvFrom
+		std::deque<SharedFrame> m_shared = {}; // the shared frames, referenced until flushed
+		uint64_t m_flushedInline = 0; // the bytes of the ring flushed since the connection
+		size_t m_sharedOffset = 0; // the bytes of the first shared frame already flushed
+		size_t m_sharedSize = 0; // the bytes of the shared frames not yet flushed
+		std::mutex m_outboundMutex = {};
+		size_t m_encrypted = 0; // the queued bytes already encrypted, at the front
+		Stats m_stats = {};
+		FlightRecorder m_recorder = {}; // empty when not compiled in
 	};
 }
 
@@ -0,0 +1,130 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "cpu.h"
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#else
+#   include <cpuid.h>
+#endif
+
+namespace zfserver::cpu
+{
+	namespace
+	{
+		struct Features
+		{
+			bool sse2 = false;
+			bool avx2 = false;
+			bool avx512bw = false;
+			bool gfni = false;
+		};
+
+		void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) noexcept
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+			for (int i = 0; i != 4; ++i)
+				regs[i] = static_cast<uint32_t>(info[i]);
+#else
+			__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		}
+
+		uint64_t xgetbv() noexcept
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+		}
+
+		Features detect() noexcept
+		{
+			static constexpr uint32_t EAX = 0, EBX = 1, ECX = 2, EDX = 3;
+
+			Features features;
+
+			uint32_t regs[4];
+			cpuid(0, 0, regs);
+			const uint32_t maxLeaf = regs[EAX];
+
+			cpuid(1, 0, regs);
+			features.sse2 = (regs[EDX] & (1U << 26)) != 0;
+
+			// the OS must save the YMM (and ZMM) registers on context switches
+			const bool osxsave = (regs[ECX] & (1U << 27)) != 0;
+			const uint64_t xcr0 = osxsave ? xgetbv() : 0;
+			const bool ymm = (xcr0 & 0x06) == 0x06;
+			const bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+			if (maxLeaf >= 7)
+			{
+				cpuid(7, 0, regs);
+				features.avx2 = ymm && (regs[EBX] & (1U << 5)) != 0;
+				features.avx512bw = zmm && (regs[EBX] & (1U << 16)) != 0 && (regs[EBX] & (1U << 30)) != 0;
+				features.gfni = (regs[ECX] & (1U << 8)) != 0;
+			}
+
+			return features;
+		}
+
+		const Features& features() noexcept
+		{
+			static const Features features = detect();
+			return features;
+		}
+	}
+
+	bool hasSSE2() noexcept
+	{
+		return features().sse2;
+	}
+
+	bool hasAVX2() noexcept
+	{
+		return features().avx2;
+	}
+
+	bool hasAVX512BW() noexcept
+	{
+		return features().avx512bw;
+	}
+
+	bool hasGFNI() noexcept
+	{
+		return features().gfni;
+	}
+}
@@ -0,0 +1,115 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "flightrecorder.h"
+
+#ifdef ZFSERVER_FLIGHT_RECORDER
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+
+namespace zfserver
+{
+	FlightRecorder::FlightRecorder()
+	{
+		// allocated up-front, recording never allocates
+		for (auto& ring : m_rings)
+			ring.slots = std::make_unique<Slot[]>(SLOT_COUNT);
+	}
+
+	void FlightRecorder::record(Direction direction, uint16_t counter, const uint8_t* frame, size_t len) noexcept
+	{
+		auto& ring = m_rings[static_cast<size_t>(direction)];
+		const uint64_t sequence = ring.next.load(std::memory_order_relaxed);
+		auto& slot = ring.slots[sequence % SLOT_COUNT];
+
+		const auto now = std::chrono::system_clock::now().time_since_epoch();
+		const size_t recorded = std::min(len, MAX_FRAME_LENGTH);
+
+		slot.sequence.store(WRITING, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot.header.sequence = sequence;
+		slot.header.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+		slot.header.counter = counter;
+		slot.header.length = static_cast<uint16_t>(len);
+		slot.header.recorded = static_cast<uint16_t>(recorded);
+		slot.header.direction = direction;
+		slot.header.reserved = 0;
+		std::memcpy(slot.data, frame, recorded);
+
+		slot.sequence.store(sequence, std::memory_order_release);
+		ring.next.store(sequence + 1, std::memory_order_release);
+	}
+
+	bool FlightRecorder::dump(const char* path, int connectionType) const noexcept
+	{
+		FILE* file = std::fopen(path, "wb");
+		if (file == nullptr)
+			return false;
+
+		// the count is rewritten once the frames are written
+		FileHeader header = { FILE_MAGIC, FILE_VERSION, static_cast<int16_t>(connectionType), 0 };
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+		// from the oldest frame kept, the decoder merges the directions on the timestamps
+		for (const auto& ring : m_rings)
+		{
+			const uint64_t next = ring.next.load(std::memory_order_acquire);
+			const uint64_t first = next > SLOT_COUNT ? next - SLOT_COUNT : 0;
+			for (uint64_t sequence = first; sequence != next && written; ++sequence)
+			{
+				// the recording goes on while dumping, the slot is copied first
+				const auto& slot = ring.slots[sequence % SLOT_COUNT];
+				if (slot.sequence.load(std::memory_order_acquire) != sequence)
+					continue;
+
+				FrameHeader frameHeader;
+				uint8_t data[MAX_FRAME_LENGTH];
+				std::memcpy(&frameHeader, &slot.header, sizeof(frameHeader));
+				std::memcpy(data, slot.data, std::min<size_t>(frameHeader.recorded, MAX_FRAME_LENGTH));
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+					continue; // overwritten during the copy
+
+				written = std::fwrite(&frameHeader, sizeof(frameHeader), 1, file) == 1 &&
+					std::fwrite(data, 1, frameHeader.recorded, file) == frameHeader.recorded;
+				++header.count;
+			}
+		}
+
+		written = written && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+		return std::fclose(file) == 0 && written;
+	}
+}
+
+#endif // ZFSERVER_FLIGHT_RECORDER
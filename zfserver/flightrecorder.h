@@ -0,0 +1,142 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_FLIGHT_RECORDER_H
+#define ZFSERVER_FLIGHT_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ZFSERVER_FLIGHT_RECORDER
+#include <atomic>
+#include <memory>
+#endif // ZFSERVER_FLIGHT_RECORDER
+
+namespace zfserver
+{
+	// In-memory recorder of the last decrypted frames of a connection, both ways.
+	// Recording is a copy into pre-allocated slots, without any formatting. The
+	// slots are written to a binary file on demand or on crash, and printed by the
+	// flightdecoder tool. Compiled in with ZFSERVER_FLIGHT_RECORDER, otherwise all
+	// the calls are empty.
+	class FlightRecorder final
+	{
+	public:
+#ifdef ZFSERVER_FLIGHT_RECORDER
+		static constexpr bool ENABLED = true;
+#else
+		static constexpr bool ENABLED = false;
+#endif // ZFSERVER_FLIGHT_RECORDER
+
+		// the number of frames kept, per direction
+		static constexpr size_t SLOT_COUNT = 256;
+		// the maximum length of a frame kept, the rest is truncated
+		static constexpr size_t MAX_FRAME_LENGTH = 1024;
+		// said in the game's chat to dump the recorders
+		static constexpr char DUMP_COMMAND[] = "/flightdump";
+
+		enum class Direction : uint8_t
+		{
+			Inbound = 0, // sent by the game
+			Outbound = 1, // sent by the server
+		};
+
+		// the binary file: a FileHeader, then FileHeader::count frames (each a FrameHeader and its bytes)
+		static constexpr uint32_t FILE_MAGIC = 0x5246465A; // "ZFFR"
+		static constexpr uint16_t FILE_VERSION = 1;
+
+#pragma pack(push, 1)
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint16_t version;
+			int16_t connectionType;
+			uint32_t count;
+		};
+
+		struct FrameHeader
+		{
+			uint64_t sequence; // per direction
+			int64_t timestamp; // microseconds since the epoch
+			uint16_t counter; // of the cipher, at the first byte of the frame
+			uint16_t length; // of the frame
+			uint16_t recorded; // the bytes following (truncated to MAX_FRAME_LENGTH)
+			Direction direction;
+			uint8_t reserved;
+		};
+#pragma pack(pop)
+
+	public:
+#ifdef ZFSERVER_FLIGHT_RECORDER
+		FlightRecorder();
+		~FlightRecorder() = default;
+
+		// records a copy of the frame
+		void record(Direction direction, uint16_t counter, const uint8_t* frame, size_t len) noexcept;
+
+		// writes the recorded frames, from the oldest, and returns whether the file was written
+		bool dump(const char* path, int connectionType) const noexcept;
+#else
+		FlightRecorder() = default;
+		~FlightRecorder() = default;
+
+		void record(Direction, uint16_t, const uint8_t*, size_t) noexcept { }
+		bool dump(const char*, int) const noexcept { return false; }
+#endif // ZFSERVER_FLIGHT_RECORDER
+
+		FlightRecorder(FlightRecorder&& other) = delete;
+		FlightRecorder(const FlightRecorder& other) = delete;
+		FlightRecorder& operator=(FlightRecorder&& other) = delete;
+		FlightRecorder& operator=(const FlightRecorder& other) = delete;
+
+#ifdef ZFSERVER_FLIGHT_RECORDER
+	private:
+		// the sequence of a slot being written
+		static constexpr uint64_t WRITING = UINT64_MAX;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> sequence = { WRITING }; // of the frame held, the dump skips the slots rewritten while copied
+			FrameHeader header;
+			uint8_t data[MAX_FRAME_LENGTH];
+		};
+
+		// a ring per direction, each has a single writer thread (the dump may run on another)
+		struct Ring
+		{
+			std::unique_ptr<Slot[]> slots;
+			std::atomic<uint64_t> next = { 0 }; // the sequence of the next frame
+		};
+
+	private:
+		Ring m_rings[2];
+#endif // ZFSERVER_FLIGHT_RECORDER
+	};
+}
+
+#endif // ZFSERVER_FLIGHT_RECORDER_H
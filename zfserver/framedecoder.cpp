@@ -0,0 +1,72 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "framedecoder.h"
+
+#include "log.h"
+
+namespace zfserver
+{
+	void FrameDecoder::clear() noexcept
+	{
+		m_buffer.clear();
+		m_complete = 0;
+		m_next = HEADER_SIZE;
+	}
+
+	FrameDecoder::Progress FrameDecoder::advance() noexcept
+	{
+		// past the header, the frame being decrypted is complete
+		if (m_next != m_complete + HEADER_SIZE)
+		{
+			m_complete = m_next;
+			m_next = m_complete + HEADER_SIZE;
+			return Progress::Complete;
+		}
+
+		network::Msg::Header header;
+		m_buffer.peek(m_complete, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+		if (header.Length < sizeof(header))
+		{
+			// the stream can't be resynchronized, drop the bytes after the valid frames
+			LOG(WARN, "Corrupted msg[%04d], len=[%03d], dropping the rest of the send", header.Type, header.Length);
+			m_buffer.truncate(m_complete);
+			return Progress::Corrupted;
+		}
+
+		// a frame without body is already complete
+		if (header.Length == sizeof(header))
+		{
+			m_complete = m_next;
+			m_next = m_complete + HEADER_SIZE;
+			return Progress::Complete;
+		}
+
+		m_next = m_complete + header.Length;
+		return Progress::Partial;
+	}
+}
@@ -0,0 +1,144 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_FRAME_DECODER_H
+#define ZFSERVER_FRAME_DECODER_H
+
+#include "ringbuffer.h"
+#include "stats.h"
+#include "trace.h"
+
+#include "network/msg.h"
+
+#include "security/tqcipher.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+
+namespace zfserver
+{
+	// Incremental decoder of the messages sent by the game. The bytes are
+	// decrypted once into a ring buffer, and the partial frames are kept
+	// until the next sends complete them. The bytes are decrypted up to the
+	// end of each frame, as a frame (MsgConnect) can change the key of the
+	// bytes after it.
+	class FrameDecoder final
+	{
+	public:
+		static constexpr size_t HEADER_SIZE = sizeof(network::Msg::Header);
+
+	public:
+		FrameDecoder() = default;
+		~FrameDecoder() = default;
+
+		FrameDecoder(FrameDecoder&& other) = delete;
+		FrameDecoder(const FrameDecoder& other) = delete;
+		FrameDecoder& operator=(FrameDecoder&& other) = delete;
+		FrameDecoder& operator=(const FrameDecoder& other) = delete;
+
+		// decrypts the bytes after the pending ones, and calls onFrame(frame, length) on
+		// each frame completed, before decrypting the bytes after it
+		template<typename Handler>
+		void feed(security::TqCipher& cipher, const uint8_t* buf, size_t len, Handler&& onFrame)
+		{
+			if (len == 0)
+				return;
+
+			stats::ScopedTimer timer(stats::latency(stats::Probe::Decrypt));
+			trace::ScopedSpan span("decrypt", "bytes", static_cast<uint32_t>(len));
+
+			while (len != 0)
+			{
+				// decrypt straight into the buffer, up to the end of the next header or frame
+				const size_t chunk = std::min(len, m_next - m_buffer.size());
+				cipher.decrypt(buf, m_buffer.reserve(chunk), chunk);
+				buf += chunk;
+				len -= chunk;
+
+				if (m_buffer.size() != m_next)
+					break; // waiting for the next send
+
+				const size_t start = m_complete;
+				switch (advance())
+				{
+				case Progress::Partial:
+					break;
+				case Progress::Complete:
+					onFrame(m_buffer.front(m_complete) + start, m_complete - start);
+					break;
+				case Progress::Corrupted:
+					cipher.skipDecrypt(len); // the rest of the send is dropped too
+					return;
+				}
+			}
+		}
+
+		// calls handler(frames, length) on the complete frames, as one contiguous batch, and returns its length
+		template<typename Handler>
+		size_t drain(Handler&& handler)
+		{
+			const size_t total = m_complete;
+			if (total == 0)
+				return 0;
+
+			handler(m_buffer.front(total), total);
+
+			// the whole batch is released at once
+			m_buffer.consume(total);
+			m_complete = 0;
+			m_next -= total;
+			return total;
+		}
+
+		// the number of bytes of the partial frames
+		size_t pending() const noexcept { return m_buffer.size(); }
+
+		// drops the pending bytes
+		void clear() noexcept;
+
+	private:
+		enum class Progress
+		{
+			Partial, // the header is complete, not the frame
+			Complete, // a frame is complete
+			Corrupted, // the pending bytes were dropped
+		};
+
+		// checks the header or the frame ending at m_next
+		Progress advance() noexcept;
+
+	private:
+		RingBuffer m_buffer = {};
+		size_t m_complete = 0; // the length of the complete frames at the front
+		size_t m_next = HEADER_SIZE; // the end of the header or of the frame being decrypted
+	};
+}
+
+#endif // ZFSERVER_FRAME_DECODER_H
@@ -0,0 +1,464 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "log.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zfserver::log
+{
+	namespace
+	{
+		// the size in bytes of the ring of each thread
+		constexpr size_t RING_SIZE = 64 * 1024;
+		// the maximum size of a record, the larger ones are dropped
+		constexpr size_t MAX_RECORD_SIZE = RING_SIZE / 4;
+		// the records are aligned in the ring, to read their header in-place
+		constexpr size_t RECORD_ALIGNMENT = alignof(Record);
+		// the delay between the batches of the writer
+		constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(10);
+		// the writer is woken up earlier when a ring is filled above this size
+		constexpr size_t WAKE_UP_SIZE = RING_SIZE / 2;
+		// the file receiving the lines
+		constexpr char LOG_FILE[] = "./log.txt";
+
+		constexpr size_t align(size_t len) noexcept
+		{
+			return (len + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+		}
+
+		// ring of the records of a thread, the writer is its only consumer
+		struct Ring
+		{
+			alignas(64) std::atomic<size_t> head = { 0 }; // the next record to format
+			alignas(64) std::atomic<size_t> tail = { 0 }; // the end of the published records
+			size_t reserved = 0; // the end of the record being written, for the thread only
+			std::atomic<bool> orphaned = { false }; // the thread exited, the ring is freed once drained
+			alignas(64) uint8_t buffer[RING_SIZE];
+		};
+
+		// the ring of the calling thread, orphaned when the thread exits
+		struct RingHandle
+		{
+			Ring* ring = nullptr;
+
+			~RingHandle()
+			{
+				if (ring != nullptr)
+					ring->orphaned = true;
+			}
+		};
+
+		thread_local RingHandle t_ring;
+
+		// set while the thread holds the locks of the logger, it can't flush (e.g. crashing in the writer)
+		thread_local bool t_locking = false;
+
+		struct LockingScope
+		{
+			LockingScope() noexcept { t_locking = true; }
+			~LockingScope() { t_locking = false; }
+		};
+
+		// appends the printf-formatted string
+		void appendf(std::string& out, const char* format, ...)
+		{
+			char buf[256];
+
+			va_list args;
+			va_start(args, format);
+			const int len = std::vsnprintf(buf, sizeof(buf), format, args);
+			va_end(args);
+
+			if (len < 0)
+				return;
+
+			if (static_cast<size_t>(len) < sizeof(buf))
+			{
+				out.append(buf, len);
+				return;
+			}
+
+			const size_t offset = out.size();
+			out.resize(offset + len + 1);
+
+			va_start(args, format);
+			std::vsnprintf(&out[offset], len + 1, format, args);
+			va_end(args);
+
+			out.resize(offset + len);
+		}
+
+		const char* basename(const char* path) noexcept
+		{
+			const char* name = path;
+			for (const char* it = path; *it != '\0'; ++it)
+			{
+				if (*it == '\\' || *it == '/')
+					name = it + 1;
+			}
+			return name;
+		}
+
+		class Logger final
+		{
+		public:
+			// never destroyed, joining the writer while the DLL is unloading would deadlock
+			static Logger& instance()
+			{
+				static Logger* logger = new Logger();
+				return *logger;
+			}
+
+		public:
+			// creates the ring of a new thread
+			Ring* attach()
+			{
+				auto ring = std::make_unique<Ring>();
+
+				LockingScope locking;
+				std::lock_guard<std::mutex> lock(m_ringsMutex);
+				m_rings.push_back(std::move(ring));
+				return m_rings.back().get();
+			}
+
+			// formats and writes the published records of all the threads
+			void flush()
+			{
+				LockingScope locking;
+				std::lock_guard<std::mutex> lock(m_writeMutex);
+
+				std::vector<Ring*> rings;
+				{
+					std::lock_guard<std::mutex> ringsLock(m_ringsMutex);
+					rings.reserve(m_rings.size());
+					for (const auto& ring : m_rings)
+						rings.push_back(ring.get());
+				}
+
+				m_batch.clear();
+				for (Ring* ring : rings)
+					drain(*ring);
+
+				const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+				if (dropped != m_reportedDropped)
+				{
+					appendf(m_batch, "[log] %llu records dropped, the rings were full\n", static_cast<unsigned long long>(dropped - m_reportedDropped));
+					m_reportedDropped = dropped;
+				}
+
+				if (m_file != nullptr && !m_batch.empty())
+				{
+					std::fwrite(m_batch.data(), 1, m_batch.size(), m_file);
+					std::fflush(m_file);
+				}
+
+				// the rings of the exited threads can't receive records anymore
+				std::lock_guard<std::mutex> ringsLock(m_ringsMutex);
+				m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const auto& ring)
+				{
+					return ring->orphaned && ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+				}), m_rings.end());
+			}
+
+			// wakes up the writer before its interval, without blocking
+			void wakeUp() noexcept
+			{
+				if (!m_wakingUp.exchange(true, std::memory_order_relaxed))
+					m_wakeUp.notify_one();
+			}
+
+			void drop() noexcept
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			uint64_t dropped() const noexcept
+			{
+				return m_dropped.load(std::memory_order_relaxed);
+			}
+
+		private:
+			Logger()
+				: m_file(std::fopen(LOG_FILE, "at"))
+			{
+				std::thread(&Logger::run, this).detach();
+			}
+
+			// the loop of the writer
+			void run()
+			{
+				for (;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock(m_sleepMutex);
+						m_wakeUp.wait_for(lock, WRITE_INTERVAL, [this]() { return m_wakingUp.load(std::memory_order_relaxed); });
+						m_wakingUp = false;
+					}
+
+					flush();
+				}
+			}
+
+			void drain(Ring& ring)
+			{
+				size_t head = ring.head.load(std::memory_order_relaxed);
+				const size_t tail = ring.tail.load(std::memory_order_acquire);
+				while (head != tail)
+				{
+					const size_t offset = head & (RING_SIZE - 1);
+					const Record& record = *reinterpret_cast<const Record*>(ring.buffer + offset);
+
+					// the rest of the ring is unused, the record is at the start
+					if (record.size == 0)
+					{
+						head += RING_SIZE - offset;
+						continue;
+					}
+
+					format(record, ring.buffer + offset + sizeof(Record), m_batch);
+					head += align(record.size);
+				}
+
+				ring.head.store(head, std::memory_order_release);
+			}
+
+			// formats the record with the arguments of their recorded type, the length modifiers
+			// of the format are replaced by the ones of the recorded (64-bit) values
+			static void format(const Record& record, const uint8_t* args, std::string& out)
+			{
+				appendf(out, "[%s:%s:%u] ", basename(record.file), record.function, record.line);
+
+				const uint8_t* arg = args;
+				const uint8_t* end = args + (record.size - sizeof(Record));
+
+				const char* it = record.format;
+				while (*it != '\0')
+				{
+					if (*it != '%')
+					{
+						const char* literal = it;
+						while (*it != '\0' && *it != '%')
+							++it;
+
+						out.append(literal, it - literal);
+						continue;
+					}
+
+					if (it[1] == '%')
+					{
+						out += '%';
+						it += 2;
+						continue;
+					}
+
+					char spec[32] = { '%' };
+					size_t length = 1;
+					for (++it; *it != '\0' && std::strchr("-+ #0123456789.", *it) != nullptr && length < 24; ++it)
+						spec[length++] = *it;
+					while (*it != '\0' && std::strchr("hljztL", *it) != nullptr)
+						++it;
+
+					const char conversion = *it;
+					if (conversion == '\0')
+						break;
+					++it;
+
+					if (arg >= end)
+					{
+						out += "<missing>";
+						continue;
+					}
+
+					const ArgType type = static_cast<ArgType>(*arg++);
+					if (type == ArgType::String)
+					{
+						uint16_t len = 0;
+						std::memcpy(&len, arg, sizeof(len));
+						const std::string str(reinterpret_cast<const char*>(arg + sizeof(len)), len);
+						arg += sizeof(len) + len;
+
+						spec[length++] = 's';
+						if (conversion == 's')
+							appendf(out, spec, str.c_str());
+						else
+							out += "<?>";
+						continue;
+					}
+
+					uint64_t value = 0;
+					std::memcpy(&value, arg, sizeof(value));
+					arg += sizeof(value);
+
+					switch (conversion)
+					{
+					case 'd':
+					case 'i':
+						std::strcpy(spec + length, "lld");
+						appendf(out, spec, static_cast<long long>(value));
+						break;
+					case 'o':
+					case 'u':
+					case 'x':
+					case 'X':
+						spec[length++] = 'l';
+						spec[length++] = 'l';
+						spec[length++] = conversion;
+						appendf(out, spec, static_cast<unsigned long long>(value));
+						break;
+					case 'c':
+						spec[length++] = 'c';
+						appendf(out, spec, static_cast<int>(value));
+						break;
+					case 'e':
+					case 'E':
+					case 'f':
+					case 'F':
+					case 'g':
+					case 'G':
+					case 'a':
+					case 'A':
+					{
+						double d = 0;
+						if (type == ArgType::Double)
+							std::memcpy(&d, &value, sizeof(d));
+						else
+							d = type == ArgType::Int ? static_cast<double>(static_cast<int64_t>(value)) : static_cast<double>(value);
+
+						spec[length++] = conversion;
+						appendf(out, spec, d);
+						break;
+					}
+					case 'p':
+						spec[length++] = 'p';
+						appendf(out, spec, reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+						break;
+					default:
+						out += "<?>"; // unsupported (or %n)
+						break;
+					}
+				}
+
+				out += '\n';
+			}
+
+		private:
+			std::mutex m_ringsMutex; // protects the list, not the rings
+			std::vector<std::unique_ptr<Ring>> m_rings;
+
+			std::mutex m_writeMutex; // a single consumer, the writer or a flush
+			std::string m_batch;
+			FILE* m_file = nullptr;
+
+			std::mutex m_sleepMutex; // only for the writer to wait
+			std::condition_variable m_wakeUp;
+			std::atomic<bool> m_wakingUp = { false };
+
+			std::atomic<uint64_t> m_dropped = { 0 };
+			uint64_t m_reportedDropped = 0;
+		};
+	}
+
+	uint8_t* reserve(size_t len) noexcept
+	{
+		Ring* ring = t_ring.ring;
+		if (ring == nullptr)
+		{
+			try
+			{
+				ring = t_ring.ring = Logger::instance().attach();
+			}
+			catch (...)
+			{
+				return nullptr; // out of memory, nothing is logged
+			}
+		}
+
+		const size_t size = align(len);
+		const size_t tail = ring->tail.load(std::memory_order_relaxed);
+		size_t offset = tail & (RING_SIZE - 1);
+
+		// the records are contiguous, the rest of the ring is skipped if too small
+		const size_t padding = RING_SIZE - offset < size ? RING_SIZE - offset : 0;
+		if (size > MAX_RECORD_SIZE || tail + padding + size - ring->head.load(std::memory_order_acquire) > RING_SIZE)
+		{
+			Logger::instance().drop();
+			return nullptr;
+		}
+
+		if (padding != 0)
+		{
+			const uint32_t end = 0;
+			std::memcpy(ring->buffer + offset, &end, sizeof(end));
+			offset = 0;
+		}
+
+		ring->reserved = tail + padding + size;
+		if (ring->reserved - ring->head.load(std::memory_order_relaxed) > WAKE_UP_SIZE)
+			Logger::instance().wakeUp();
+
+		return ring->buffer + offset;
+	}
+
+	void commit() noexcept
+	{
+		Ring* ring = t_ring.ring;
+		ring->tail.store(ring->reserved, std::memory_order_release);
+	}
+
+	void flush() noexcept
+	{
+		// the records being written aren't published yet, only the locks of the thread would deadlock
+		if (t_locking)
+			return;
+
+		try
+		{
+			Logger::instance().flush();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	uint64_t dropped() noexcept
+	{
+		return Logger::instance().dropped();
+	}
+}
@@ -29,36 +29,20 @@
 #ifndef ZFSERVER_LOG_H
 #define ZFSERVER_LOG_H
 
-#include <cstdio>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 
-// Note. This is really awful/slow logger. But it helps debugging.
+#include <algorithm>
+#include <new>
+#include <type_traits>
 
-// __FILENAME__ is a suggested macro, until it exists, using __FILE__
-#ifndef __FILENAME__
-#   define __FILENAME__ (std::strrchr(__FILE__, '\\') ? std::strrchr(__FILE__, '\\') + 1 : __FILE__)
-#endif // __FILENAME__
+// Asynchronous binary logger. A call only copies the format pointer and the raw
+// arguments in a lock-free ring of the calling thread, and a background thread
+// formats and writes the records in batches. The calls below the minimum level
+// are compiled out.
 
-static FILE* logfile = fopen("./log.txt", "at");
-
-// temp
-#ifdef _NDEBUG
-#define LOG__(LEVEL, FILE, FUNCTION, LINE, FORMAT, ...) \
-    if (LEVEL > LogLevel::LOG_LEVEL_DBG) \
-        std::fprintf(logfile, "[%s:%s:%u] ", FILE, FUNCTION, LINE), std::fprintf(logfile, FORMAT, ## __VA_ARGS__), std::fprintf(logfile, "\n"), std::fflush(logfile)
-#else
-#define LOG__(LEVEL, FILE, FUNCTION, LINE, FORMAT, ...) \
-    if (LEVEL >= LogLevel::LOG_LEVEL_DBG) \
-        std::fprintf(logfile, "[%s:%s:%u] ", FILE, FUNCTION, LINE), std::fprintf(logfile, FORMAT, ## __VA_ARGS__), std::fprintf(logfile, "\n"), std::fflush(logfile)
-#endif // _NDEBUG
-
-#define LOG_(LEVEL, ...) \
-    LOG__(LEVEL, __FILENAME__, __FUNCTION__, __LINE__, __VA_ARGS__)
-
-#define LOG(LEVEL, ...) LOG_(LogLevel::LOG_LEVEL_ ## LEVEL, __VA_ARGS__)
-
-
-enum class LogLevel
+enum class LogLevel : uint8_t
 {
 	LOG_LEVEL_VRB = 0,
 	LOG_LEVEL_DBG = 1,
@@ -68,4 +52,195 @@ enum class LogLevel
 	LOG_LEVEL_CRIT = 5
 };
 
+// the minimum level compiled in, can be overridden by the build
+#ifndef ZFSERVER_LOG_MIN_LEVEL
+#   ifdef NDEBUG
+#       define ZFSERVER_LOG_MIN_LEVEL LogLevel::LOG_LEVEL_INFO
+#   else
+#       define ZFSERVER_LOG_MIN_LEVEL LogLevel::LOG_LEVEL_DBG
+#   endif // NDEBUG
+#endif // ZFSERVER_LOG_MIN_LEVEL
+
+// the format must be a literal, only its pointer is kept until the record is formatted
+#define LOG__(LEVEL, FILE, FUNCTION, LINE, FORMAT, ...) \
+    do { \
+        if constexpr (LEVEL >= ZFSERVER_LOG_MIN_LEVEL) \
+            zfserver::log::write(LEVEL, FILE, FUNCTION, LINE, FORMAT, ## __VA_ARGS__); \
+    } while (false)
+
+#define LOG_(LEVEL, ...) \
+    LOG__(LEVEL, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+
+#define LOG(LEVEL, ...) LOG_(LogLevel::LOG_LEVEL_ ## LEVEL, __VA_ARGS__)
+
+namespace zfserver::log
+{
+	// the header of a record, followed by the arguments
+	struct Record
+	{
+		uint32_t size; // the size of the record, arguments included (0 marks the end of the ring)
+		uint32_t line;
+		LogLevel level;
+		const char* file;
+		const char* function;
+		const char* format;
+	};
+
+	// the type of an argument, before its value
+	enum class ArgType : uint8_t
+	{
+		Int,
+		UInt,
+		Double,
+		Pointer,
+		String, // followed by its length (uint16_t) and its characters
+	};
+
+	// the maximum length of the strings, the rest is truncated
+	constexpr size_t MAX_STRING_LENGTH = 512;
+
+	// reserves a record in the ring of the calling thread, nullptr if full (the record is dropped)
+	[[nodiscard]] uint8_t* reserve(size_t len) noexcept;
+
+	// publishes the record reserved last
+	void commit() noexcept;
+
+	// writes all the published records (blocking), unless the thread was interrupted in the logger
+	void flush() noexcept;
+
+	// the number of records dropped, as the ring was full
+	uint64_t dropped() noexcept;
+
+	namespace detail
+	{
+		template<typename T>
+		constexpr bool IS_STRING = std::is_same_v<std::decay_t<T>, const char*> || std::is_same_v<std::decay_t<T>, char*>;
+
+		// the conversion of the next argument in the format, parsed as the formatter does ('\0' if none)
+		inline char nextConversion(const char*& it) noexcept
+		{
+			while (*it != '\0')
+			{
+				if (*it++ != '%')
+					continue;
+
+				if (*it == '%')
+				{
+					++it;
+					continue;
+				}
+
+				while (*it != '\0' && std::strchr("-+ #0123456789.hljztL", *it) != nullptr)
+					++it;
+				return *it != '\0' ? *it++ : '\0';
+			}
+			return '\0';
+		}
+
+		inline const char* nonNull(const char* str) noexcept
+		{
+			return str != nullptr ? str : "(null)";
+		}
+
+		inline size_t stringLength(const char* str) noexcept
+		{
+			return std::min(std::strlen(nonNull(str)), MAX_STRING_LENGTH);
+		}
+
+		// a C string printed with %p is recorded as a pointer, it may not be terminated
+		template<typename T>
+		size_t argSize(const T& arg, bool asPointer) noexcept
+		{
+			if constexpr (IS_STRING<T>)
+				return asPointer ? sizeof(ArgType) + sizeof(uint64_t) : sizeof(ArgType) + sizeof(uint16_t) + stringLength(arg);
+			else if constexpr (std::is_floating_point_v<T>)
+				return sizeof(ArgType) + sizeof(double);
+			else
+				return sizeof(ArgType) + sizeof(uint64_t);
+		}
+
+		template<typename T>
+		uint8_t* encode(uint8_t* dst, const T& arg, bool asPointer) noexcept
+		{
+			static_assert(IS_STRING<T> || std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+				"only the arithmetic types, the enums, the pointers and the C strings can be logged");
+
+			ArgType type;
+			uint64_t value = 0;
+			if constexpr (IS_STRING<T>)
+			{
+				if (!asPointer)
+				{
+					// the string may not outlive the call, it's copied
+					const uint16_t length = static_cast<uint16_t>(stringLength(arg));
+					*dst++ = static_cast<uint8_t>(ArgType::String);
+					std::memcpy(dst, &length, sizeof(length));
+					std::memcpy(dst + sizeof(length), nonNull(arg), length);
+					return dst + sizeof(length) + length;
+				}
+
+				type = ArgType::Pointer;
+				value = reinterpret_cast<uintptr_t>(arg);
+			}
+			else if constexpr (std::is_floating_point_v<T>)
+			{
+				const double d = static_cast<double>(arg);
+				type = ArgType::Double;
+				std::memcpy(&value, &d, sizeof(d));
+			}
+			else if constexpr (std::is_pointer_v<T>)
+			{
+				type = ArgType::Pointer;
+				value = reinterpret_cast<uintptr_t>(arg);
+			}
+			else if constexpr (std::is_enum_v<T>)
+			{
+				type = std::is_signed_v<std::underlying_type_t<T>> ? ArgType::Int : ArgType::UInt;
+				value = static_cast<uint64_t>(arg);
+			}
+			else
+			{
+				type = std::is_signed_v<T> ? ArgType::Int : ArgType::UInt;
+				value = static_cast<uint64_t>(static_cast<std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>(arg));
+			}
+
+			*dst++ = static_cast<uint8_t>(type);
+			std::memcpy(dst, &value, sizeof(value));
+			return dst + sizeof(value);
+		}
+	}
+
+	template<typename... Args>
+	void write(LogLevel level, const char* file, const char* function, uint32_t line, const char* format, const Args&... args) noexcept
+	{
+		// the format is only parsed when a C string could be printed with %p
+		bool asPointer[sizeof...(Args) + 1] = {};
+		if constexpr ((detail::IS_STRING<Args> || ... || false))
+		{
+			const char* it = format;
+			for (size_t i = 0; i != sizeof...(Args); ++i)
+				asPointer[i] = detail::nextConversion(it) == 'p';
+		}
+
+		size_t len = sizeof(Record);
+		size_t i = 0;
+		((len += detail::argSize(args, asPointer[i++])), ...);
+
+		uint8_t* record = reserve(len);
+		if (record == nullptr)
+			return;
+
+		new (record) Record{ static_cast<uint32_t>(len), line, level, file, function, format };
+
+		if constexpr (sizeof...(Args) != 0)
+		{
+			uint8_t* dst = record + sizeof(Record);
+			i = 0;
+			((dst = detail::encode(dst, args, asPointer[i++])), ...);
+		}
+
+		commit();
+	}
+}
+
 #endif // ZFSERVER_LOG_H
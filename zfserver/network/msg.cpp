@@ -30,6 +30,8 @@
 
 #include "client.h"
 #include "log.h"
+#include "stats.h"
+#include "trace.h"
 
 #include "network/msgaccount.h"
 #include "network/msgaction.h"
@@ -41,42 +43,152 @@
 #include <cassert>
 #include <cctype>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <utility>
+
 namespace zfserver::network
 {
+	namespace
+	{
+		/**
+		 * The handler of a type of message.
+		 */
+		struct Handler
+		{
+			/** The minimum length in bytes of the message, checked before any allocation */
+			size_t minLength;
+			/** Create an owning message */
+			std::unique_ptr<Msg> (*create)(const uint8_t* buf, size_t len);
+			/** Process a view of the message */
+			void (*process)(uint8_t* buf, size_t len, Client& client, Connection& connection);
+			/** The index of the handler in HANDLERS, for its latency stats */
+			size_t index;
+			/** The name of the message, for the trace spans */
+			const char* name;
+		};
+
+		template<typename T>
+		std::unique_ptr<Msg> createMsg(const uint8_t* buf, const size_t len)
+		{
+			return std::make_unique<T>(buf, len);
+		}
+
+		template<typename T>
+		void processView(uint8_t* buf, const size_t len, Client& client, Connection& connection)
+		{
+			T msg{ buf, len, Msg::VIEW };
+			msg.process(client, connection);
+		}
+
+		template<typename T>
+		constexpr std::pair<uint16_t, Handler> entry(uint16_t type, const char* name) noexcept
+		{
+			return { type, { T::Layout::MIN_LENGTH, &createMsg<T>, &processView<T>, 0, name } };
+		}
+
+		/** All the handled types of message. */
+		constexpr std::pair<uint16_t, Handler> HANDLERS[] = {
+			entry<MsgAccount>(MSG_ACCOUNT, "MsgAccount"),
+			entry<MsgAction>(MSG_ACTION, "MsgAction"),
+			entry<MsgConnect>(MSG_CONNECT, "MsgConnect"),
+			entry<MsgItem>(MSG_ITEM, "MsgItem"),
+			entry<MsgTalk>(MSG_TALK, "MsgTalk"),
+			entry<MsgWalk>(MSG_WALK, "MsgWalk"),
+		};
+
+		static_assert(std::size(HANDLERS) <= stats::HANDLER_COUNT, "the stats can't time all the handlers");
+
+		constexpr size_t tableSize() noexcept
+		{
+			size_t size = 0;
+			for (const auto& [type, handler] : HANDLERS)
+				size = std::max<size_t>(size, type - MSG_GENERAL + 1);
+			return size;
+		}
+
+		/** The handlers, indexed by Type - MSG_GENERAL (null handlers for unknown types). */
+		constexpr std::array<Handler, tableSize()> makeTable() noexcept
+		{
+			std::array<Handler, tableSize()> table = {};
+			for (size_t i = 0; i < std::size(HANDLERS); ++i)
+			{
+				const auto& [type, handler] = HANDLERS[i];
+				table[type - MSG_GENERAL] = handler;
+				table[type - MSG_GENERAL].index = i;
+			}
+			return table;
+		}
+
+		constexpr std::array<Handler, tableSize()> TABLE = makeTable();
+
+		/** Find the handler of the type, or null if the type is unknown. */
+		const Handler* findHandler(uint16_t type) noexcept
+		{
+			if (type < MSG_GENERAL || static_cast<size_t>(type - MSG_GENERAL) >= TABLE.size())
+				return nullptr;
+
+			const Handler& handler = TABLE[type - MSG_GENERAL];
+			return handler.process != nullptr ? &handler : nullptr;
+		}
+
+		std::atomic<size_t> s_unknownCount = 0; //!< the number of messages of unknown type
+	}
+
 	std::unique_ptr<Msg> Msg::create(const uint8_t* buf, const size_t len)
 	{
 		assert(buf != nullptr);
 		assert(len >= sizeof(Msg::Header));
 
-		std::unique_ptr<Msg> msg = nullptr;
+		const Msg::Header* header = reinterpret_cast<const Msg::Header*>(buf);
+		const Handler* handler = findHandler(header->Type);
+		if (handler == nullptr)
+		{
+			s_unknownCount.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		if (len < handler->minLength)
+		{
+			LOG(WARN, "Truncated msg[%04d], len=[%03zu], expected at least %zu", header->Type, len, handler->minLength);
+			return nullptr;
+		}
+
+		return handler->create(buf, len);
+	}
+
+	void Msg::dispatch(uint8_t* buf, const size_t len, Client& client, Connection& connection)
+	{
+		assert(buf != nullptr);
+		assert(len >= sizeof(Msg::Header));
 
 		const Msg::Header* header = reinterpret_cast<const Msg::Header*>(buf);
-		switch (header->Type)
+		stats::count(stats::Direction::Received, header->Type, len);
+
+		const Handler* handler = findHandler(header->Type);
+		if (handler == nullptr)
 		{
-		case MSG_ACCOUNT:
-			msg = std::make_unique<MsgAccount>(buf, len);
-			break;
-		case MSG_ACTION:
-			msg = std::make_unique<MsgAction>(buf, len);
-			break;
-		case MSG_CONNECT:
-			msg = std::make_unique<MsgConnect>(buf, len);
-			break;
-		case MSG_ITEM:
-			msg = std::make_unique<MsgItem>(buf, len);
-			break;
-		case MSG_TALK:
-			msg = std::make_unique<MsgTalk>(buf, len);
-			break;
-		case MSG_WALK:
-			msg = std::make_unique<MsgWalk>(buf, len);
-			break;
-		default:
-			msg = std::make_unique<Msg>(buf, len);
-			break;
+			s_unknownCount.fetch_add(1, std::memory_order_relaxed);
+			LOG(VRB, "Unknown msg[%04d], len=[%03d]", header->Type, header->Length);
+			return;
 		}
 
-		return msg;
+		if (len < handler->minLength)
+		{
+			LOG(WARN, "Truncated msg[%04d], len=[%03zu], expected at least %zu", header->Type, len, handler->minLength);
+			return;
+		}
+
+		stats::ScopedTimer timer(stats::latency(handler->index, header->Type));
+		trace::ScopedSpan span(handler->name, "type", header->Type);
+		handler->process(buf, len, client, connection);
+	}
+
+	size_t Msg::unknownCount() noexcept
+	{
+		return s_unknownCount.load(std::memory_order_relaxed);
 	}
 
 	Msg::Msg(const uint8_t* buf, const size_t len)
@@ -85,29 +197,39 @@ namespace zfserver::network
 		assert(buf != nullptr);
 		assert(len >= sizeof(Msg::Header));
 
-		m_buffer = std::make_unique<uint8_t[]>(m_length);
-		std::memcpy(m_buffer.get(), buf, len);
+		m_buffer = MsgPool::instance().allocate(m_length);
+		m_data = m_buffer.get();
+		std::memcpy(m_data, buf, len);
+	}
+
+	Msg::Msg(uint8_t* buf, const size_t len, ViewTag) noexcept
+		: m_buffer(nullptr), m_data(buf), m_length(len)
+	{
+		assert(buf != nullptr);
+		assert(len >= sizeof(Msg::Header));
 	}
 
 	Msg::Msg(const size_t len)
 		: m_length(len)
 	{
-		m_buffer = std::make_unique<uint8_t[]>(m_length);
-		std::memset(m_buffer.get(), 0, m_length);
+		m_buffer = MsgPool::instance().allocate(m_length);
+		m_data = m_buffer.get();
+		std::memset(m_data, 0, m_length);
 	}
 
 	Msg::Msg(Msg&& other) noexcept
-		: m_buffer(std::move(other.m_buffer)), m_length(other.m_length)
+		: m_buffer(std::move(other.m_buffer)), m_data(other.m_data), m_length(other.m_length)
 	{
 		other.m_buffer = nullptr;
+		other.m_data = nullptr;
 		other.m_length = 0;
 	}
 
 	Msg::Msg(const Msg& other)
 		: Msg(other.m_length)
 	{
-		// copy the data
-		std::memcpy(m_buffer.get(), other.m_buffer.get(), other.m_length);
+		// copy the data (a copy of a view owns its buffer)
+		std::memcpy(m_data, other.m_data, other.m_length);
 	}
 
 	Msg& Msg::operator=(Msg&& other) noexcept
@@ -116,8 +238,10 @@ namespace zfserver::network
 		{
 			m_length = 0;
 			m_buffer = nullptr;
+			m_data = nullptr;
 
 			std::swap(m_buffer, other.m_buffer);
+			std::swap(m_data, other.m_data);
 			std::swap(m_length, other.m_length);
 		}
 
@@ -129,18 +253,19 @@ namespace zfserver::network
 		if (&other != this)
 		{
 			m_length = other.m_length;
-			m_buffer = std::make_unique<uint8_t[]>(m_length);
+			m_buffer = MsgPool::instance().allocate(m_length);
 
-			// copy the data
-			std::memcpy(m_buffer.get(), other.m_buffer.get(), other.m_length);
+			// copy the data (a copy of a view owns its buffer)
+			std::memcpy(m_buffer.get(), other.m_data, other.m_length);
+			m_data = m_buffer.get();
 		}
 
 		return *this;
 	}
 
-	void Msg::process(Client& client, Connection& connection)
+	void Msg::process(Client&, Connection&)
 	{
-		const Msg::Header* header = reinterpret_cast<const Msg::Header*>(m_buffer.get());
+		const Msg::Header* header = reinterpret_cast<const Msg::Header*>(m_data);
 		LOG(WARN, "Unknown msg[%04d], len=[%03d]", header->Type, header->Length);
 
 		dump(*this);
@@ -34,6 +34,7 @@
 
 #include <memory>
 
+#include "msgpool.h"
 #include "networkdef.h"
 
 namespace zfserver
@@ -61,17 +62,41 @@ namespace zfserver::network
 			uint16_t Type;
 		}Header;
 
+		/**
+		 * Tag of the constructors creating a non-owning view of a buffer.
+		 */
+		struct ViewTag { explicit ViewTag() = default; };
+		static constexpr ViewTag VIEW{};
+
 	public:
 		/**
 		 * Create a message object from the specified buffer.
-		 * The buffer will be took by the object and the memory
-		 * freed when the object will be destroyed.
+		 * The buffer is copied in the message.
+		 *
+		 * @param[in] buf  the buffer to copy
+		 * @param[in] len  the length in bytes of the buffer
+		 *
+		 * @returns the message, or null if the type is unknown (counted)
+		 *          or if the buffer is shorter than the type requires
+		 */
+		[[nodiscard]] static std::unique_ptr<Msg> create(const uint8_t* buf, size_t len);
 
-		 * @param[in,out] buf  a pointer to the buffer to take
-							   the pointer will be set to null
-		 * @param[in]     len  the length in bytes of the buffer
+		/**
+		 * Process the message in the specified buffer without copying it.
+		 * The message is a view of the buffer, and the handlers might modify
+		 * the buffer in-place. A handler must copy the message to keep it.
+		 *
+		 * @param[in,out] buf         the buffer of the message
+		 * @param[in]     len         the length in bytes of the buffer
+		 * @param[in]     client      the client which has sent the message
+		 * @param[in]     connection  the connection on which the message was sent
 		 */
-		static [[nodiscard]] std::unique_ptr<Msg> create(const uint8_t* buf, size_t len);
+		static void dispatch(uint8_t* buf, size_t len, Client& client, Connection& connection);
+
+		/**
+		 * Get the number of messages of unknown type seen by create() and dispatch().
+		 */
+		static size_t unknownCount() noexcept;
 
 		/**
 		 * Print the msg in the standard output stream.
@@ -92,6 +117,16 @@ namespace zfserver::network
 		 */
 		Msg(const uint8_t* buf, size_t len);
 
+		/**
+		 * Create a message view of the specified buffer.
+		 * The buffer must outlive the message. A copy of the message
+		 * always owns its buffer.
+		 *
+		 * @param[in] buf  the buffer to view
+		 * @param[in] len  the length in bytes of the buffer
+		 */
+		Msg(uint8_t* buf, size_t len, ViewTag) noexcept;
+
 		Msg(Msg&& other) noexcept;
 		Msg(const Msg& other);
 		Msg& operator=(Msg&& other) noexcept;
@@ -112,11 +147,14 @@ namespace zfserver::network
 
 	public:
 		/** Get a pointer of the buffer. It may not be the internal one. */
-		[[nodiscard]] const uint8_t* buffer() const noexcept { return m_buffer.get(); }
+		[[nodiscard]] const uint8_t* buffer() const noexcept { return m_data; }
 
 		/** Get the length in bytes of the message. */
 		[[nodiscard]] size_t length() const noexcept { return m_length; }
 
+		/** Check whether the message is a view of a buffer it doesn't own. */
+		[[nodiscard]] bool isView() const noexcept { return m_buffer == nullptr && m_data != nullptr; }
+
 	protected:
 		/**
 		 * Create a message object with an internal buffer of
@@ -128,10 +166,11 @@ namespace zfserver::network
 
 		/** Reinterpret the buffer as T. */
 		template<typename T>
-		[[nodiscard]] T* bufferAs() noexcept { return reinterpret_cast<T*>(m_buffer.get()); }
+		[[nodiscard]] T* bufferAs() noexcept { return reinterpret_cast<T*>(m_data); }
 
 	private:
-		std::unique_ptr<uint8_t[]> m_buffer; //!< the internal buffer
+		MsgPool::Buffer m_buffer; //!< the internal buffer, from the pool (null for a view)
+		uint8_t* m_data; //!< the data of the message (the internal or the viewed buffer)
 		size_t m_length; //!< the length in bytes of the buffer
 	};
 }
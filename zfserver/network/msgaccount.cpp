@@ -42,41 +42,7 @@ using namespace std::literals;
 
 namespace zfserver::network
 {
-	MsgAccount::MsgAccount(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
-	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgAccount::MsgAccount(MsgAccount&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgAccount::MsgAccount(const MsgAccount& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgAccount& MsgAccount::operator=(MsgAccount&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgAccount& MsgAccount::operator=(const MsgAccount& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	void MsgAccount::process(Client& client, Connection& connection)
+	void MsgAccount::process(Client&, Connection& connection)
 	{
 		static constexpr uint8_t RC5_SEED[security::RC5::KEY_SIZE] = { 0x3C, 0xDC, 0xFE, 0xE8, 0xC4, 0x54, 0xD6, 0x7E, 0x16, 0xA6, 0xF8, 0x1A, 0xE8, 0xD0, 0x38, 0xBE };
 
@@ -84,12 +50,13 @@ namespace zfserver::network
 		static constexpr int32_t ACCOUNT_UID = 123456789;
 		static constexpr int32_t ACCOUNT_TOKEN = 987654321;
 
-		security::RC5 cipher{ RC5_SEED };
-		cipher.decrypt(reinterpret_cast<uint8_t*>(m_info->Password), sizeof(m_info->Password));
+		// the key schedule of the constant seed is done at compile-time
+		static constexpr security::RC5 CIPHER{ RC5_SEED };
+		CIPHER.decrypt(reinterpret_cast<uint8_t*>(info().Password), sizeof(info().Password));
 
 		LOG(DBG, "Requesting login for %s with password %s on %s",
-			m_info->Account, m_info->Password, m_info->Server);
+			info().Account, info().Password, info().Server);
 
-		connection.sendTo(MsgConnectEx{ ACCOUNT_UID, ACCOUNT_TOKEN, "192.0.2.1"sv, Client::MSGSERVER_PORT });
+		connection.emplace<MsgConnectEx>(ACCOUNT_UID, ACCOUNT_TOKEN, "192.0.2.1"sv, Client::MSGSERVER_PORT);
 	}
 }
\ No newline at end of file
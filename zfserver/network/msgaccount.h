@@ -29,14 +29,14 @@
 #ifndef ZFSERVER_NETWORK_MSG_ACCOUNT_H
 #define ZFSERVER_NETWORK_MSG_ACCOUNT_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver::network
 {
 	/**
 	 * First msg sent to the AccServer to request a new connection.
 	 */
-	class MsgAccount final : public Msg
+	class MsgAccount final : public MsgSchema<MsgAccount>
 	{
 	public:
 #pragma pack(push, 1)
@@ -53,22 +53,15 @@ namespace zfserver::network
 		}MsgInfo;
 #pragma pack(pop)
 
-	public:
-		/**
-		 * Create a message object from the specified buffer.
-		 *
-		 * @param[in] buf  the buffer to copy
-		 * @param[in] len  the length in bytes of the buffer
-		 */
-		MsgAccount(const uint8_t* buf, size_t len);
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_ACCOUNT;
+		/** The layout of the message. */
+		using Layout = FixedLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 52, "Unexpected layout of the MsgInfo.");
 
-		MsgAccount(MsgAccount&& other) noexcept;
-		MsgAccount(const MsgAccount& other);
-		MsgAccount& operator=(MsgAccount&& other) noexcept;
-		MsgAccount& operator=(const MsgAccount& other);
-
-		/* destructor */
-		~MsgAccount() override = default;
+	public:
+		/* create a message object or a view from the specified buffer */
+		using MsgSchema::MsgSchema;
 
 		/**
 		 * Process the message received from the client.
@@ -77,9 +70,6 @@ namespace zfserver::network
 		 * @param[in] connection  the connection on which the message was sent
 		 */
 		void process(Client& client, Connection& connection) override;
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
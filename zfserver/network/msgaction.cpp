@@ -37,95 +37,61 @@
 
 namespace zfserver::network
 {
-	MsgAction::MsgAction(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
-	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgAction::MsgAction(MsgAction&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgAction::MsgAction(const MsgAction& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgAction& MsgAction::operator=(MsgAction&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgAction& MsgAction::operator=(const MsgAction& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
 	void MsgAction::process(Client& client, Connection& connection)
 	{
-		auto& player = client.player();
+		[[maybe_unused]] auto& player = client.player();
 
-		switch (m_info->Action)
+		switch (info().Action)
 		{
 		case Action::EnterMap: // Login Sequence - Part 1
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 
-			m_info->PosX = 400;
-			m_info->PosY = 400;
-			m_info->Data = 1002;
-			m_info->Direction = 0;
+			info().PosX = 400;
+			info().PosY = 400;
+			info().Data = 1002;
+			info().Direction = 0;
 
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::GetItems: // Login Sequence - Part 2
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::GetFriends: // Login Sequence - Part 3
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::GetWeaponSkills: // Login Sequence - Part 4
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::GetMagicSkills: // Login Sequence - Part 5
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::GetSyndicate: // Login Sequence - Part 6
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			connection.sendTo(*this);
 			break;
 		}
 		case Action::CompleteLogin: // Login Sequence - Part 7
 		{
-			assert(m_info->UniqId == player.uid());
+			assert(info().UniqId == player.uid());
 			break;
 		}
 		default:
-			LOG(WARN, "Unknown action[%04u], data=[%d]", m_info->Action, m_info->Data);
+			LOG(WARN, "Unknown action[%04u], data=[%d]", info().Action, info().Data);
 			break;
 		}
 	}
@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_ACTION_H
 #define ZFSERVER_NETWORK_MSG_ACTION_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver::network
 {
@@ -40,7 +40,7 @@ namespace zfserver::network
 	 * The MsgServer can also send those msgs to the client to signal a small
 	 * action.
 	 */
-	class MsgAction final : public Msg
+	class MsgAction final : public MsgSchema<MsgAction>
 	{
 	public:
 		enum class Action : uint16_t
@@ -128,26 +128,19 @@ namespace zfserver::network
 			/** The direction of the entity */
 			uint16_t Direction;
 			/** The action Id */
-			Action Action;
+			MsgAction::Action Action;
 		}MsgInfo;
 #pragma pack(pop)
 
-	public:
-		/**
-		 * Create a message object from the specified buffer.
-		 *
-		 * @param[in] buf  the buffer to copy
-		 * @param[in] len  the length in bytes of the buffer
-		 */
-		MsgAction(const uint8_t* buf, size_t len);
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_ACTION;
+		/** The layout of the message. */
+		using Layout = FixedLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 24, "Unexpected layout of the MsgInfo.");
 
-		MsgAction(MsgAction&& other) noexcept;
-		MsgAction(const MsgAction& other);
-		MsgAction& operator=(MsgAction&& other) noexcept;
-		MsgAction& operator=(const MsgAction& other);
-
-		/* destructor */
-		~MsgAction() override = default;
+	public:
+		/* create a message object or a view from the specified buffer */
+		using MsgSchema::MsgSchema;
 
 		/**
 		 * Process the message received from the client.
@@ -156,9 +149,6 @@ namespace zfserver::network
 		 * @param[in] connection  the connection on which the message was sent
 		 */
 		void process(Client& client, Connection& connection) override;
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
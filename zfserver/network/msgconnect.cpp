@@ -39,38 +39,16 @@
 
 namespace zfserver::network
 {
-	MsgConnect::MsgConnect(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
+	void MsgConnect::generateAltKey(Connection& connection, const uint8_t* buf, size_t len)
 	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgConnect::MsgConnect(MsgConnect&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
+		if (connection.type() != ConnectionType::MsgServer || len < Layout::MIN_LENGTH)
+			return;
 
-	MsgConnect::MsgConnect(const MsgConnect& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
+		const MsgInfo& info = *reinterpret_cast<const MsgInfo*>(buf);
 
-	}
-
-	MsgConnect& MsgConnect::operator=(MsgConnect&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgConnect& MsgConnect::operator=(const MsgConnect& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
+		// the encryption counter is reset too, while the responses may be encrypted on the server thread
+		auto lock = connection.lockOutbound();
+		connection.cipher().generateAltKey(info.Data, info.AccountUID);
 	}
 
 	void MsgConnect::process(Client& client, Connection& connection)
@@ -85,17 +63,15 @@ namespace zfserver::network
 		case ConnectionType::MsgServer:
 		{
 			LOG(VRB, "MsgConnect::process on fake MsgServer.");
-			LOG(INFO, "AccountUID=%d, Data=%d", m_info->Data, m_info->AccountUID);
-
-			auto& cipher = connection.cipher();
-			cipher.generateAltKey(m_info->Data, m_info->AccountUID);
+			LOG(INFO, "AccountUID=%d, Data=%d", info().Data, info().AccountUID);
 
+			// the cipher already uses the alternative key, see generateAltKey
 			auto& player = client.player();
 
-			connection.sendTo(MsgTalk{ "SYSTEM", "ALLUSERS", "ANSWER_OK", Channel::Entrance });
-			connection.sendTo(MsgUserInfo{ player });
+			connection.emplace<MsgTalk>("SYSTEM", "ALLUSERS", "ANSWER_OK", Channel::Entrance);
+			connection.emplace<MsgUserInfo>(player);
 
-			connection.sendTo(MsgTalk{ "SYSTEM", player.name(), "zfserver virtual server...", Channel::Normal });
+			connection.emplace<MsgTalk>("SYSTEM", player.name(), "zfserver virtual server...", Channel::Normal);
 
 			break;
 		}
@@ -29,14 +29,14 @@
 #ifndef ZFSERVER_NETWORK_MSG_CONNECT_H
 #define ZFSERVER_NETWORK_MSG_CONNECT_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver::network
 {
     /**
      * Msg sent by the AccServer to answer to a connection request.
      */
-    class MsgConnect final : public Msg
+    class MsgConnect final : public MsgSchema<MsgConnect>
     {
     public:
         #pragma pack(push, 1)
@@ -53,22 +53,27 @@ namespace zfserver::network
         }MsgInfo;
         #pragma pack(pop)
 
+        /** The type of the message. */
+        static constexpr uint16_t TYPE = MSG_CONNECT;
+        /** The layout of the message. */
+        using Layout = FixedLayout<MsgInfo>;
+        static_assert(Layout::MIN_LENGTH == 28, "Unexpected layout of the MsgInfo.");
+
     public:
         /**
-         * Create a message object from the specified buffer.
+         * Switch the cipher of the MsgServer to the alternative key of the message,
+         * as soon as it's decrypted. The bytes after the message use the new key, even
+         * if the message is processed later on the server thread.
          *
-         * @param[in] buf  the buffer to copy
-         * @param[in] len  the length in bytes of the buffer
+         * @param[in] connection  the connection on which the message was sent
+         * @param[in] buf         the decrypted message
+         * @param[in] len         the length in bytes of the message
          */
-        MsgConnect(const uint8_t* buf, size_t len);
-
-        MsgConnect(MsgConnect&& other) noexcept;
-        MsgConnect(const MsgConnect& other);
-        MsgConnect& operator=(MsgConnect&& other) noexcept;
-        MsgConnect& operator=(const MsgConnect& other);
+        static void generateAltKey(Connection& connection, const uint8_t* buf, size_t len);
 
-        /* destructor */
-        ~MsgConnect() = default;
+    public:
+        /* create a message object or a view from the specified buffer */
+        using MsgSchema::MsgSchema;
 
         /**
          * Process the message received from the client.
@@ -77,9 +82,6 @@ namespace zfserver::network
          * @param[in] connection  the connection on which the message was sent
          */
         void process(Client& client, Connection& connection) override;
-
-    private:
-        MsgInfo* m_info; //!< the casted internal reference to the buffer
     };
 }
 
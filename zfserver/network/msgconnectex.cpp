@@ -32,50 +32,25 @@
 
 namespace zfserver::network
 {
-	MsgConnectEx::MsgConnectEx(const int32_t accountUID, const int32_t data, std::string_view info, const uint16_t port)
-		: Msg(sizeof(MsgInfo)), m_info(bufferAs<MsgInfo>())
+	MsgConnectEx::MsgConnectEx(const int32_t accountUID, const int32_t data, std::string_view serverInfo, const uint16_t port)
+		: MsgSchema(Layout::length())
 	{
-		create(accountUID, data, info, port);
+		create(accountUID, data, serverInfo, port);
 	}
 
-	MsgConnectEx::MsgConnectEx(MsgConnectEx&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
+	MsgConnectEx::MsgConnectEx(MsgSink& sink, const int32_t accountUID, const int32_t data, std::string_view serverInfo, const uint16_t port)
+		: MsgSchema(sink, Layout::length())
 	{
-
-	}
-
-	MsgConnectEx::MsgConnectEx(const MsgConnectEx& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgConnectEx& MsgConnectEx::operator=(MsgConnectEx&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
+		create(accountUID, data, serverInfo, port);
 	}
 
-	MsgConnectEx& MsgConnectEx::operator=(const MsgConnectEx& other)
+	void MsgConnectEx::create(const int32_t accountUID, const int32_t data, std::string_view serverInfo, const uint16_t port)
 	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	void MsgConnectEx::create(const int32_t accountUID, const int32_t data, std::string_view info, const uint16_t port)
-	{
-		assert(info.size() < MAX_NAMESIZE);
-
-		m_info->Header.Length = static_cast<uint16_t>(length());
-		m_info->Header.Type = MSG_CONNECTEX;
+		assert(serverInfo.size() < MAX_NAMESIZE);
 
-		m_info->AccountUID = accountUID;
-		m_info->Data = data;
-		std::memcpy(m_info->Info, info.data(), info.size());
-		m_info->Port = port;
+		info().AccountUID = accountUID;
+		info().Data = data;
+		std::memcpy(info().Info, serverInfo.data(), serverInfo.size());
+		info().Port = port;
 	}
 }
\ No newline at end of file
@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_CONNECTEX_H
 #define ZFSERVER_NETWORK_MSG_CONNECTEX_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 #include <string_view>
 
@@ -38,7 +38,7 @@ namespace zfserver::network
 	/**
 	 * Msg sent by the AccServer to answer to a connection request.
 	 */
-	class MsgConnectEx final : public Msg
+	class MsgConnectEx final : public MsgSchema<MsgConnectEx>
 	{
 	public:
 #pragma pack(push, 1)
@@ -57,6 +57,12 @@ namespace zfserver::network
 		}MsgInfo;
 #pragma pack(pop)
 
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_CONNECTEX;
+		/** The layout of the message. */
+		using Layout = FixedLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 32, "Unexpected layout of the MsgInfo.");
+
 	public:
 		/**
 		 * Create a new MsgConnect for the specified account.
@@ -68,20 +74,20 @@ namespace zfserver::network
 		 */
 		MsgConnectEx(int32_t aAccUID, int32_t aData, std::string_view aInfo, uint16_t aPort);
 
-		MsgConnectEx(MsgConnectEx&& other) noexcept;
-		MsgConnectEx(const MsgConnectEx& other);
-		MsgConnectEx& operator=(MsgConnectEx&& other) noexcept;
-		MsgConnectEx& operator=(const MsgConnectEx& other);
-
-		/* destructor */
-		~MsgConnectEx() = default;
+		/**
+		 * Serialize a new MsgConnect in-place in the sink.
+		 *
+		 * @param sink[in]      the destination of the msg
+		 * @param aAccUID[in]   the account UID
+		 * @param aData[in]     the session ID
+		 * @param aInfo[in]     the game server IP address
+		 * @param aPort[in]     the game server port
+		 */
+		MsgConnectEx(MsgSink& sink, int32_t aAccUID, int32_t aData, std::string_view aInfo, uint16_t aPort);
 
 	private:
 		/* internal filling of the packet */
 		void create(int32_t aAccUID, int32_t aData, std::string_view aInfo, uint16_t aPort);
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
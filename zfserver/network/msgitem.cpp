@@ -37,45 +37,11 @@
 
 namespace zfserver::network
 {
-	MsgItem::MsgItem(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
-	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgItem::MsgItem(MsgItem&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgItem::MsgItem(const MsgItem& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgItem& MsgItem::operator=(MsgItem&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgItem& MsgItem::operator=(const MsgItem& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
 	void MsgItem::process(Client& client, Connection& connection)
 	{
-		auto& player = client.player();
+		[[maybe_unused]] auto& player = client.player();
 
-		switch (m_info->Action)
+		switch (info().Action)
 		{
 		case Action::CompleteTask:
 		{
@@ -83,7 +49,7 @@ namespace zfserver::network
 			break;
 		}
 		default:
-			LOG(WARN, "Unknown action[%04u], data=[%d]", m_info->Action, m_info->Data);
+			LOG(WARN, "Unknown action[%04u], data=[%d]", info().Action, info().Data);
 			break;
 		}
 	}
@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_ITEM_H
 #define ZFSERVER_NETWORK_MSG_ITEM_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver::network
 {
@@ -37,7 +37,7 @@ namespace zfserver::network
 	 * Msg sent to the MsgServer to signal small item actions like equiping,
 	 * buying, selling, dropping...
 	 */
-	class MsgItem final : public Msg
+	class MsgItem final : public MsgSchema<MsgItem>
 	{
 	public:
 		enum class Action : uint32_t
@@ -121,28 +121,21 @@ namespace zfserver::network
 			};
 
 			/** The action Id */
-			Action Action;
+			MsgItem::Action Action;
 			/** The timestamp of the msg. */
 			uint32_t Timestamp;
 		}MsgInfo;
 #pragma pack(pop)
 
-	public:
-		/**
-		 * Create a message object from the specified buffer.
-		 *
-		 * @param[in] buf  the buffer to copy
-		 * @param[in] len  the length in bytes of the buffer
-		 */
-		MsgItem(const uint8_t* buf, size_t len);
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_ITEM;
+		/** The layout of the message. */
+		using Layout = FixedLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 20, "Unexpected layout of the MsgInfo.");
 
-		MsgItem(MsgItem&& other) noexcept;
-		MsgItem(const MsgItem& other);
-		MsgItem& operator=(MsgItem&& other) noexcept;
-		MsgItem& operator=(const MsgItem& other);
-
-		/* destructor */
-		~MsgItem() override = default;
+	public:
+		/* create a message object or a view from the specified buffer */
+		using MsgSchema::MsgSchema;
 
 		/**
 		 * Process the message received from the client.
@@ -151,9 +144,6 @@ namespace zfserver::network
 		 * @param[in] connection  the connection on which the message was sent
 		 */
 		void process(Client& client, Connection& connection) override;
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
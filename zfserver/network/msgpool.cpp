@@ -0,0 +1,197 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "msgpool.h"
+
+#include <cassert>
+
+namespace zfserver::network
+{
+	MsgPool& MsgPool::instance()
+	{
+		// never destroyed, the threads return their cached buffers on exit
+		static MsgPool* pool = new MsgPool();
+		return *pool;
+	}
+
+	MsgPool::ThreadCache& MsgPool::threadCache() noexcept
+	{
+		static thread_local ThreadCache cache;
+		return cache;
+	}
+
+	MsgPool::ThreadCache::~ThreadCache()
+	{
+		MsgPool& pool = MsgPool::instance();
+		for (size_t i = 0; i != CLASS_COUNT; ++i)
+		{
+			CachedList& list = lists[i];
+			if (list.head == nullptr)
+				continue;
+
+			Node* last = list.head;
+			while (last->next != nullptr)
+				last = last->next;
+
+			pool.pushChain(i, list.head, last);
+			list = {};
+		}
+	}
+
+	MsgPool::Buffer MsgPool::allocate(size_t len)
+	{
+		const size_t index = classOf(len);
+		SizeClass& sizeClass = m_classes[index];
+
+		if (index == CLASS_COUNT)
+		{
+			acquired(sizeClass, false);
+			return Buffer(new uint8_t[len], Deleter{ len });
+		}
+
+		CachedList& list = threadCache().lists[index];
+		bool hit = true;
+
+		if (list.head == nullptr)
+		{
+			// take all the free buffers of the class (no ABA issue with an exchange)
+			list.head = sizeClass.free.exchange(nullptr, std::memory_order_acquire);
+			for (Node* node = list.head; node != nullptr; node = node->next)
+				++list.count;
+		}
+
+		if (list.head == nullptr)
+		{
+			carveSlab(index, list);
+			hit = false;
+		}
+
+		Node* node = list.head;
+		list.head = node->next;
+		--list.count;
+
+		acquired(sizeClass, hit);
+		return Buffer(reinterpret_cast<uint8_t*>(node), Deleter{ len });
+	}
+
+	void MsgPool::Deleter::operator()(uint8_t* buf) const noexcept
+	{
+		if (buf != nullptr)
+			MsgPool::instance().deallocate(buf, len);
+	}
+
+	void MsgPool::deallocate(uint8_t* buf, size_t len) noexcept
+	{
+		const size_t index = classOf(len);
+		m_classes[index].inUse.fetch_sub(1, std::memory_order_relaxed);
+
+		if (index == CLASS_COUNT)
+		{
+			delete[] buf;
+			return;
+		}
+
+		CachedList& list = threadCache().lists[index];
+
+		Node* node = reinterpret_cast<Node*>(buf);
+		node->next = list.head;
+		list.head = node;
+		++list.count;
+
+		if (list.count > MAX_CACHED)
+		{
+			// keep half of the buffers, and share the others
+			Node* last = list.head;
+			for (size_t i = 1; i != MAX_CACHED / 2; ++i)
+				last = last->next;
+
+			Node* first = last->next;
+			last->next = nullptr;
+
+			last = first;
+			while (last->next != nullptr)
+				last = last->next;
+
+			pushChain(index, first, last);
+			list.count = MAX_CACHED / 2;
+		}
+	}
+
+	void MsgPool::pushChain(size_t index, Node* first, Node* last) noexcept
+	{
+		assert(first != nullptr && last != nullptr);
+
+		std::atomic<Node*>& free = m_classes[index].free;
+
+		Node* head = free.load(std::memory_order_relaxed);
+		do
+		{
+			last->next = head;
+		} while (!free.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void MsgPool::carveSlab(size_t index, CachedList& list)
+	{
+		const size_t size = CLASS_SIZES[index];
+
+		// the slabs are never released, the buffers go back to the free lists
+		uint8_t* slab = new uint8_t[SLAB_SIZE];
+		for (size_t offset = SLAB_SIZE; offset >= size; offset -= size)
+		{
+			Node* node = reinterpret_cast<Node*>(slab + offset - size);
+			node->next = list.head;
+			list.head = node;
+			++list.count;
+		}
+	}
+
+	void MsgPool::acquired(SizeClass& sizeClass, bool hit) noexcept
+	{
+		(hit ? sizeClass.hits : sizeClass.misses).fetch_add(1, std::memory_order_relaxed);
+
+		const size_t inUse = sizeClass.inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+		size_t highWater = sizeClass.highWater.load(std::memory_order_relaxed);
+		while (inUse > highWater && !sizeClass.highWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed))
+			;
+	}
+
+	std::array<MsgPool::Stats, MsgPool::CLASS_COUNT + 1> MsgPool::stats() const noexcept
+	{
+		std::array<Stats, CLASS_COUNT + 1> stats = {};
+		for (size_t i = 0; i != stats.size(); ++i)
+		{
+			const SizeClass& sizeClass = m_classes[i];
+			stats[i].size = i != CLASS_COUNT ? CLASS_SIZES[i] : 0;
+			stats[i].hits = sizeClass.hits.load(std::memory_order_relaxed);
+			stats[i].misses = sizeClass.misses.load(std::memory_order_relaxed);
+			stats[i].inUse = sizeClass.inUse.load(std::memory_order_relaxed);
+			stats[i].highWater = sizeClass.highWater.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,182 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_NETWORK_MSG_POOL_H
+#define ZFSERVER_NETWORK_MSG_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace zfserver::network
+{
+	/**
+	 * Slab pool of the message buffers.
+	 *
+	 * The buffers are grouped in size classes matching the Conquer Online messages
+	 * (most are under 256 bytes, and none is above 1 KiB). The free buffers are cached
+	 * per thread, and exchanged in chains with a lock-free global list per class.
+	 * The larger buffers are allocated on the heap.
+	 */
+	class MsgPool final
+	{
+	public:
+		/** The size in bytes of the buffers of each class. */
+		static constexpr std::array<size_t, 5> CLASS_SIZES = { 64, 128, 256, 512, 1024 };
+		/** The number of size classes. */
+		static constexpr size_t CLASS_COUNT = CLASS_SIZES.size();
+		/** The size in bytes of the slabs carved in buffers. */
+		static constexpr size_t SLAB_SIZE = 64 * 1024;
+		/** The maximum number of free buffers cached by a thread, per class. */
+		static constexpr size_t MAX_CACHED = 256;
+
+		/**
+		 * The counters of a size class.
+		 */
+		struct Stats
+		{
+			/** The size in bytes of the buffers (0 for the heap allocations) */
+			size_t size;
+			/** The number of allocations served by a free buffer */
+			uint64_t hits;
+			/** The number of allocations which needed a new slab (or the heap) */
+			uint64_t misses;
+			/** The number of buffers in use */
+			size_t inUse;
+			/** The highest number of buffers in use */
+			size_t highWater;
+		};
+
+		/**
+		 * Release a buffer into the pool.
+		 */
+		struct Deleter
+		{
+			/** The length in bytes of the buffer */
+			size_t len = 0;
+
+			void operator()(uint8_t* buf) const noexcept;
+		};
+
+		/** A buffer of the pool. */
+		using Buffer = std::unique_ptr<uint8_t[], Deleter>;
+
+	public:
+		/** Get the shared pool. */
+		static MsgPool& instance();
+
+		/**
+		 * Allocate a buffer of at least the specified length.
+		 * The content of the buffer is undefined.
+		 *
+		 * @param[in] len  the length in bytes of the buffer
+		 */
+		[[nodiscard]] Buffer allocate(size_t len);
+
+		/**
+		 * Get the counters of the size classes, followed by the
+		 * counters of the heap allocations.
+		 */
+		[[nodiscard]] std::array<Stats, CLASS_COUNT + 1> stats() const noexcept;
+
+	public:
+		MsgPool() = default;
+		~MsgPool() = default;
+
+		MsgPool(MsgPool&&) = delete;
+		MsgPool(const MsgPool&) = delete;
+		MsgPool& operator=(MsgPool&&) = delete;
+		MsgPool& operator=(const MsgPool&) = delete;
+
+	private:
+		/** A free buffer, linked to the next one. */
+		struct Node
+		{
+			Node* next;
+		};
+
+		/** The free buffers of a size class, cached by a thread. */
+		struct CachedList
+		{
+			Node* head = nullptr;
+			size_t count = 0;
+		};
+
+		/** The free buffers of a thread, returned to the pool when the thread exits. */
+		struct ThreadCache
+		{
+			std::array<CachedList, CLASS_COUNT> lists = {};
+
+			~ThreadCache();
+		};
+
+		/** The shared state of a size class. */
+		struct alignas(64) SizeClass
+		{
+			std::atomic<Node*> free = { nullptr }; //!< the free buffers not cached by any thread
+			std::atomic<uint64_t> hits = { 0 };
+			std::atomic<uint64_t> misses = { 0 };
+			std::atomic<size_t> inUse = { 0 };
+			std::atomic<size_t> highWater = { 0 };
+		};
+
+		/* get the size class of the length (CLASS_COUNT for the heap) */
+		static constexpr size_t classOf(size_t len) noexcept
+		{
+			for (size_t i = 0; i != CLASS_COUNT; ++i)
+			{
+				if (len <= CLASS_SIZES[i])
+					return i;
+			}
+			return CLASS_COUNT;
+		}
+
+		/* the free buffers of the calling thread */
+		static ThreadCache& threadCache() noexcept;
+
+		/* release a buffer of the specified length */
+		void deallocate(uint8_t* buf, size_t len) noexcept;
+
+		/* push a chain of free buffers on the global list of the class */
+		void pushChain(size_t index, Node* first, Node* last) noexcept;
+
+		/* carve a new slab in free buffers for the cached list */
+		void carveSlab(size_t index, CachedList& list);
+
+		/* account an allocation of the class */
+		void acquired(SizeClass& sizeClass, bool hit) noexcept;
+
+	private:
+		std::array<SizeClass, CLASS_COUNT + 1> m_classes = {}; //!< the size classes, and the heap
+	};
+}
+
+#endif // ZFSERVER_NETWORK_MSG_POOL_H
@@ -0,0 +1,218 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_NETWORK_MSG_SCHEMA_H
+#define ZFSERVER_NETWORK_MSG_SCHEMA_H
+
+#include "msg.h"
+#include "msgsink.h"
+#include "stringpacker.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+namespace zfserver::network
+{
+	/**
+	 * Layout of a message made of its fixed-size MsgInfo only.
+	 */
+	template<typename Info>
+	struct FixedLayout
+	{
+		static_assert(std::is_standard_layout_v<Info> && std::is_trivially_copyable_v<Info>,
+			"The MsgInfo must be a plain struct.");
+		static_assert(alignof(Info) == 1, "The MsgInfo must be packed.");
+		static_assert(offsetof(Info, Header) == 0, "The MsgInfo must start with the header.");
+
+		/** Whether the message ends with a string pack */
+		static constexpr bool HAS_STRINGS = false;
+		/** The minimum length in bytes of the message */
+		static constexpr size_t MIN_LENGTH = sizeof(Info);
+
+		/** Get the length in bytes of a serialized message. */
+		static constexpr size_t length() noexcept { return sizeof(Info); }
+	};
+
+	/**
+	 * Layout of a message ending with a string pack (MsgInfo::StringPack).
+	 */
+	template<typename Info>
+	struct StringPackLayout
+	{
+		static_assert(std::is_standard_layout_v<Info> && std::is_trivially_copyable_v<Info>,
+			"The MsgInfo must be a plain struct.");
+		static_assert(alignof(Info) == 1, "The MsgInfo must be packed.");
+		static_assert(offsetof(Info, Header) == 0, "The MsgInfo must start with the header.");
+		static_assert(offsetof(Info, StringPack) + 1 == sizeof(Info), "The string pack must end the MsgInfo.");
+
+		/** Whether the message ends with a string pack */
+		static constexpr bool HAS_STRINGS = true;
+		/** The offset in bytes of the string pack */
+		static constexpr size_t STRINGS_OFFSET = offsetof(Info, StringPack);
+		/** The minimum length in bytes of the message (an empty pack) */
+		static constexpr size_t MIN_LENGTH = STRINGS_OFFSET + 1;
+
+		/** Get the length in bytes of a serialized message with the strings. */
+		static constexpr size_t length(std::initializer_list<std::string_view> strings) noexcept
+		{
+			size_t len = MIN_LENGTH;
+			for (std::string_view str : strings)
+				len += 1 + str.size();
+			return len;
+		}
+	};
+
+	/**
+	 * Base of the messages declared by a schema. The message class T declares
+	 * its fields once in its packed MsgInfo, its TYPE, and its Layout (FixedLayout
+	 * or StringPackLayout). The schema generates the constructors, the header
+	 * of the serialized messages, and the accessors.
+	 *
+	 * The accessors reinterpret the buffer when called, so there is no pointer
+	 * to fix-up when the message is copied or moved.
+	 */
+	template<typename T>
+	class MsgSchema : public Msg
+	{
+	public:
+		/**
+		 * Create a message object from the specified buffer.
+		 *
+		 * @param[in] buf  the buffer to copy
+		 * @param[in] len  the length in bytes of the buffer
+		 */
+		MsgSchema(const uint8_t* buf, size_t len)
+			: Msg(buf, len)
+		{
+			assert(len >= T::Layout::MIN_LENGTH);
+		}
+
+		/**
+		 * Create a message view of the specified buffer.
+		 * The buffer must outlive the message, unless copied.
+		 *
+		 * @param[in] buf  the buffer to view
+		 * @param[in] len  the length in bytes of the buffer
+		 */
+		MsgSchema(uint8_t* buf, size_t len, ViewTag tag) noexcept
+			: Msg(buf, len, tag)
+		{
+			assert(len >= T::Layout::MIN_LENGTH);
+		}
+
+	protected:
+		/**
+		 * Create a zeroed message of the specified length, with its header.
+		 *
+		 * @param[in] len  the length in bytes of the message
+		 */
+		explicit MsgSchema(size_t len)
+			: Msg(len)
+		{
+			assert(len >= T::Layout::MIN_LENGTH);
+			assert(len <= UINT16_MAX);
+
+			writeHeader(len);
+		}
+
+		/**
+		 * Create a zeroed message of the specified length, with its header,
+		 * directly in the space reserved in the sink. The message is a view
+		 * of the reserved space.
+		 *
+		 * @param[in] sink  the destination of the message
+		 * @param[in] len   the length in bytes of the message
+		 */
+		MsgSchema(MsgSink& sink, size_t len)
+			: Msg(sink.reserve(len), len, VIEW)
+		{
+			assert(len <= UINT16_MAX);
+
+			std::memset(bufferAs<uint8_t>(), 0, len);
+			writeHeader(len);
+		}
+
+		/** Get the fields of the message. */
+		[[nodiscard]] auto& info() noexcept { return *bufferAs<typename T::MsgInfo>(); }
+
+		/** Get the fields of the message. */
+		[[nodiscard]] const auto& info() const noexcept { return *reinterpret_cast<const typename T::MsgInfo*>(buffer()); }
+
+		/**
+		 * Get a string of the pack, or nothing if the string is missing or
+		 * goes past the end of the message.
+		 *
+		 * @param[in] index  the index of the string (0 is the first string)
+		 */
+		[[nodiscard]] std::optional<std::string_view> string(uint8_t index) const
+		{
+			static_assert(T::Layout::HAS_STRINGS, "The message has no string pack.");
+			return packer().getString(index);
+		}
+
+		/**
+		 * Append the strings at the end of the pack.
+		 * The message must have been created with the length of all its strings.
+		 *
+		 * @param[in] strings  the strings to append
+		 */
+		void addStrings(std::initializer_list<std::string_view> strings)
+		{
+			static_assert(T::Layout::HAS_STRINGS, "The message has no string pack.");
+
+			StringPacker packer = this->packer();
+			for (std::string_view str : strings)
+				packer.addString(str);
+		}
+
+	private:
+		/* write the header of a serialized message */
+		void writeHeader(size_t len) noexcept
+		{
+			Header& header = *bufferAs<Header>();
+			header.Length = static_cast<uint16_t>(len);
+			header.Type = T::TYPE;
+		}
+
+		/* the packer of the strings, bounded by the length of the message */
+		StringPacker packer() const
+		{
+			constexpr size_t offset = T::Layout::STRINGS_OFFSET;
+			return StringPacker(const_cast<uint8_t*>(buffer()) + offset, length() - offset);
+		}
+	};
+}
+
+#endif // ZFSERVER_NETWORK_MSG_SCHEMA_H
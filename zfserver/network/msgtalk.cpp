@@ -28,8 +28,10 @@
 
 #include "msgtalk.h"
 
+#include "client.h"
+#include "flightrecorder.h"
 #include "log.h"
-#include "network/stringpacker.h"
+#include "trace.h"
 
 #include <cassert>
 
@@ -40,48 +42,15 @@ using namespace std::literals;
 namespace zfserver::network
 {
 	MsgTalk::MsgTalk(std::string_view speaker, std::string_view hearer, std::string_view words, Channel channel, Color color)
-		: Msg(sizeof(MsgInfo) +
-			1 + speaker.size() +
-			1 + hearer.size() +
-			1 + /* emotion.size() + */
-			1 + words.size())
-		, m_info(bufferAs<MsgInfo>())
+		: MsgSchema(Layout::length({ speaker, hearer, ""sv, words }))
 	{
 		create(speaker, hearer, ""sv, words, channel, color);
 	}
 
-	MsgTalk::MsgTalk(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
+	MsgTalk::MsgTalk(MsgSink& sink, std::string_view speaker, std::string_view hearer, std::string_view words, Channel channel, Color color)
+		: MsgSchema(sink, Layout::length({ speaker, hearer, ""sv, words }))
 	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgTalk::MsgTalk(MsgTalk&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgTalk::MsgTalk(const MsgTalk& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgTalk& MsgTalk::operator=(MsgTalk&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgTalk& MsgTalk::operator=(const MsgTalk& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
+		create(speaker, hearer, ""sv, words, channel, color);
 	}
 
 	void MsgTalk::create(std::string_view speaker, std::string_view hearer, std::string_view emotion, std::string_view words, Channel channel, Color color)
@@ -91,32 +60,34 @@ namespace zfserver::network
 		assert(emotion.size() < MAX_NAMESIZE);
 		assert(words.size() < MAX_WORDSSIZE);
 
-		m_info->Header.Length = static_cast<uint16_t>(length());
-		m_info->Header.Type = MSG_TALK;
-
-		m_info->Color = color;
-		m_info->Channel = channel;
-		m_info->Style = Style::Normal;
-		m_info->Timestamp = GetTickCount();
+		info().Color = color;
+		info().Channel = channel;
+		info().Style = Style::Normal;
+		info().Timestamp = GetTickCount();
 
-		StringPacker packer(m_info->StringPack);
-		packer.addString(speaker);
-		packer.addString(hearer);
-		packer.addString(emotion);
-		packer.addString(words);
+		addStrings({ speaker, hearer, emotion, words });
 	}
 
-	void MsgTalk::process(Client& client, Connection& connection)
+	void MsgTalk::process(Client& client, Connection&)
 	{
-		StringPacker packer(m_info->StringPack);
-		auto speaker = packer.getString(0);
-		auto hearer = packer.getString(1);
-		auto words = packer.getString(3);
+		auto speaker = string(0);
+		auto hearer = string(1);
+		auto words = string(3);
 
 		assert(speaker.has_value());
 		assert(hearer.has_value());
 		assert(words.has_value());
 
 		LOG(DBG, "%s said %s to %s", std::string{ *speaker }.c_str(), std::string{ *words }.c_str(), std::string{ *hearer }.c_str());
+
+		// on demand, from the game's chat
+		if constexpr (FlightRecorder::ENABLED)
+		{
+			if (words && *words == FlightRecorder::DUMP_COMMAND)
+				client.dumpFlightRecorders();
+		}
+
+		if (words && *words == trace::DUMP_COMMAND)
+			trace::dump();
 	}
 }
\ No newline at end of file
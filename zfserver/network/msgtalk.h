@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_TALK_H
 #define ZFSERVER_NETWORK_MSG_TALK_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 #include <string_view>
 
@@ -97,7 +97,7 @@ namespace zfserver::network
 	/**
 	 * Msg sent by the AccServer to answer to a connection request.
 	 */
-	class MsgTalk final : public Msg
+	class MsgTalk final : public MsgSchema<MsgTalk>
 	{
 	public:
 		enum class Style : uint16_t
@@ -114,33 +114,30 @@ namespace zfserver::network
 		{
 			/** Generic header of all msgs */
 			Msg::Header Header;
-			Color Color; // ARGB code
-			Channel Channel;
-			Style Style;
+			network::Color Color; // ARGB code
+			network::Channel Channel;
+			MsgTalk::Style Style;
 			int32_t Timestamp;
 			uint8_t StringPack[1]; // Speaker, Hearer, Emotion, Words
 		}MsgInfo;
 #pragma pack(pop)
 
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_TALK;
+		/** The layout of the message. */
+		using Layout = StringPackLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 17, "Unexpected layout of the MsgInfo.");
+
 	public:
 		MsgTalk(std::string_view speaker, std::string_view hearer, std::string_view words,
 			Channel channel, Color color = Color::White);
 
-		/**
-		 * Create a message object from the specified buffer.
-		 *
-		 * @param[in] buf  the buffer to copy
-		 * @param[in] len  the length in bytes of the buffer
-		 */
-		MsgTalk(const uint8_t* buf, size_t len);
-
-		MsgTalk(MsgTalk&& other) noexcept;
-		MsgTalk(const MsgTalk& other);
-		MsgTalk& operator=(MsgTalk&& other) noexcept;
-		MsgTalk& operator=(const MsgTalk& other);
+		/* serialize the message in-place in the sink */
+		MsgTalk(MsgSink& sink, std::string_view speaker, std::string_view hearer, std::string_view words,
+			Channel channel, Color color = Color::White);
 
-		/* destructor */
-		~MsgTalk() override = default;
+		/* create a message object or a view from the specified buffer */
+		using MsgSchema::MsgSchema;
 
 		/**
 		 * Process the message received from the client.
@@ -154,9 +151,6 @@ namespace zfserver::network
 		/* internal filling of the packet */
 		void create(std::string_view speaker, std::string_view hearer, std::string_view emotion, std::string_view words,
 			Channel channel, Color color);
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
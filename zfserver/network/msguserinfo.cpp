@@ -30,47 +30,20 @@
 
 #include "player.h"
 
-#include "network/stringpacker.h"
-
 #include <cassert>
 
 namespace zfserver::network
 {
 	MsgUserInfo::MsgUserInfo(const Player& aPlayer)
-		: Msg(sizeof(MsgInfo) +
-			1 + aPlayer.name().size() +
-			1 + aPlayer.mate().size())
-		, m_info(bufferAs<MsgInfo>())
+		: MsgSchema(Layout::length({ aPlayer.name(), aPlayer.mate() }))
 	{
 		create(aPlayer);
 	}
 
-	MsgUserInfo::MsgUserInfo(MsgUserInfo&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgUserInfo::MsgUserInfo(const MsgUserInfo& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgUserInfo& MsgUserInfo::operator=(MsgUserInfo&& other) noexcept
+	MsgUserInfo::MsgUserInfo(MsgSink& sink, const Player& aPlayer)
+		: MsgSchema(sink, Layout::length({ aPlayer.name(), aPlayer.mate() }))
 	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgUserInfo& MsgUserInfo::operator=(const MsgUserInfo& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
+		create(aPlayer);
 	}
 
 	void MsgUserInfo::create(const Player& aPlayer)
@@ -78,30 +51,25 @@ namespace zfserver::network
 		assert(aPlayer.name().size() < MAX_NAMESIZE);
 		assert(aPlayer.mate().size() < MAX_NAMESIZE);
 
-		m_info->Header.Length = static_cast<uint16_t>(length());
-		m_info->Header.Type = MSG_USERINFO;
-
-		m_info->UniqId = aPlayer.uid();
-		m_info->Look = aPlayer.look();
-		m_info->Hair = aPlayer.hair();
-		m_info->Money = aPlayer.money();
-		m_info->Exp = aPlayer.experience();
-		m_info->Force = aPlayer.force();
-		m_info->Health = aPlayer.health();
-		m_info->Dexterity = aPlayer.dexterity();
-		m_info->Soul = aPlayer.soul();
-		m_info->AddPoints = aPlayer.addPoints();
-		m_info->CurHP = aPlayer.curHP();
-		m_info->CurMP = aPlayer.curMP();
-		m_info->PkPoints = aPlayer.pkPoints();
-		m_info->Level = aPlayer.level();
-		m_info->Profession = aPlayer.profession();
-		m_info->AutoAllot = aPlayer.autoAllot() ? 1 : 0;
-		m_info->Metempsychosis = aPlayer.metempsychosis();
-		m_info->ShowName = 1;
-
-		StringPacker packer(m_info->StringPack);
-		packer.addString(aPlayer.name());
-		packer.addString(aPlayer.mate());
+		info().UniqId = aPlayer.uid();
+		info().Look = aPlayer.look();
+		info().Hair = aPlayer.hair();
+		info().Money = aPlayer.money();
+		info().Exp = aPlayer.experience();
+		info().Force = aPlayer.force();
+		info().Health = aPlayer.health();
+		info().Dexterity = aPlayer.dexterity();
+		info().Soul = aPlayer.soul();
+		info().AddPoints = aPlayer.addPoints();
+		info().CurHP = aPlayer.curHP();
+		info().CurMP = aPlayer.curMP();
+		info().PkPoints = aPlayer.pkPoints();
+		info().Level = aPlayer.level();
+		info().Profession = aPlayer.profession();
+		info().AutoAllot = aPlayer.autoAllot() ? 1 : 0;
+		info().Metempsychosis = aPlayer.metempsychosis();
+		info().ShowName = 1;
+
+		addStrings({ aPlayer.name(), aPlayer.mate() });
 	}
 }
\ No newline at end of file
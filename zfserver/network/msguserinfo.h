@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_USERINFO_H
 #define ZFSERVER_NETWORK_MSG_USERINFO_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver
 {
@@ -41,7 +41,7 @@ namespace zfserver::network
 	/**
 	 * Msg sent to the client by the MsgServer to fill all the player variables.
 	 */
-	class MsgUserInfo final : public Msg
+	class MsgUserInfo final : public MsgSchema<MsgUserInfo>
 	{
 	public:
 #pragma pack(push, 1)
@@ -96,6 +96,12 @@ namespace zfserver::network
 		}MsgInfo;
 #pragma pack(pop)
 
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_USERINFO;
+		/** The layout of the message. */
+		using Layout = StringPackLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 62, "Unexpected layout of the MsgInfo.");
+
 	public:
         /**
          * Create a new MsgUserInfo packet for the specified player.
@@ -104,20 +110,17 @@ namespace zfserver::network
          */
         MsgUserInfo(const Player& aPlayer);
 
-        MsgUserInfo(MsgUserInfo&& other) noexcept;
-        MsgUserInfo(const MsgUserInfo& other);
-        MsgUserInfo& operator=(MsgUserInfo&& other) noexcept;
-        MsgUserInfo& operator=(const MsgUserInfo& other);
-
-		/* destructor */
-		~MsgUserInfo() = default;
+        /**
+         * Serialize a new MsgUserInfo packet in-place in the sink.
+         *
+         * @param[in]   sink        the destination of the packet
+         * @param[in]   aPlayer     a reference to the player object
+         */
+        MsgUserInfo(MsgSink& sink, const Player& aPlayer);
 
 	private:
         /* internal filling of the packet */
         void create(const Player& aPlayer);
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
@@ -32,41 +32,7 @@
 
 namespace zfserver::network
 {
-	MsgWalk::MsgWalk(const uint8_t* buf, const size_t len)
-		: Msg(buf, len), m_info(bufferAs<MsgInfo>())
-	{
-		assert(len >= sizeof(MsgInfo));
-	}
-
-	MsgWalk::MsgWalk(MsgWalk&& other) noexcept
-		: Msg(std::move(other)), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgWalk::MsgWalk(const MsgWalk& other)
-		: Msg(other), m_info(bufferAs<MsgInfo>())
-	{
-
-	}
-
-	MsgWalk& MsgWalk::operator=(MsgWalk&& other) noexcept
-	{
-		Msg::operator=(std::move(other));
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	MsgWalk& MsgWalk::operator=(const MsgWalk& other)
-	{
-		Msg::operator=(other);
-		m_info = bufferAs<MsgInfo>();
-
-		return *this;
-	}
-
-	void MsgWalk::process(Client& client, Connection& connection)
+	void MsgWalk::process(Client&, Connection&)
 	{
 
 	}
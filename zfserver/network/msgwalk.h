@@ -29,7 +29,7 @@
 #ifndef ZFSERVER_NETWORK_MSG_WALK_H
 #define ZFSERVER_NETWORK_MSG_WALK_H
 
-#include "msg.h"
+#include "msgschema.h"
 
 namespace zfserver::network
 {
@@ -37,7 +37,7 @@ namespace zfserver::network
 	 * Msg sent to the client by the MsgServer or by the client to the MsgServer to
 	 * indicate a deplacement in a specific direction by walking or running.
 	 */
-	class MsgWalk final : public Msg
+	class MsgWalk final : public MsgSchema<MsgWalk>
 	{
 	public:
 #pragma pack(push, 1)
@@ -56,22 +56,15 @@ namespace zfserver::network
 		}MsgInfo;
 #pragma pack(pop)
 
-	public:
-		/**
-		 * Create a message object from the specified buffer.
-		 *
-		 * @param[in] buf  the buffer to copy
-		 * @param[in] len  the length in bytes of the buffer
-		 */
-		MsgWalk(const uint8_t* buf, size_t len);
+		/** The type of the message. */
+		static constexpr uint16_t TYPE = MSG_WALK;
+		/** The layout of the message. */
+		using Layout = FixedLayout<MsgInfo>;
+		static_assert(Layout::MIN_LENGTH == 12, "Unexpected layout of the MsgInfo.");
 
-		MsgWalk(MsgWalk&& other) noexcept;
-		MsgWalk(const MsgWalk& other);
-		MsgWalk& operator=(MsgWalk&& other) noexcept;
-		MsgWalk& operator=(const MsgWalk& other);
-
-		/* destructor */
-		~MsgWalk() override = default;
+	public:
+		/* create a message object or a view from the specified buffer */
+		using MsgSchema::MsgSchema;
 
 		/**
 		 * Process the message received from the client.
@@ -80,9 +73,6 @@ namespace zfserver::network
 		 * @param[in] connection  the connection on which the message was sent
 		 */
 		void process(Client& client, Connection& connection) override;
-
-	private:
-		MsgInfo* m_info; //!< the casted internal reference to the buffer
 	};
 }
 
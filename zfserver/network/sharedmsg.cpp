@@ -0,0 +1,124 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "sharedmsg.h"
+
+#include "network/msg.h"
+#include "network/msgpool.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <new>
+
+namespace zfserver::network
+{
+	SharedMsg::SharedMsg(const Msg& msg)
+		: SharedMsg(msg.buffer(), msg.length())
+	{
+
+	}
+
+	SharedMsg::SharedMsg(const uint8_t* buf, const size_t len)
+	{
+		assert(buf != nullptr);
+		assert(len <= UINT32_MAX);
+
+		uint8_t* data = MsgPool::instance().allocate(sizeof(Block) + len).release();
+		m_block = new (data) Block{ { 1 }, static_cast<uint32_t>(len) };
+		std::memcpy(data + sizeof(Block), buf, len);
+	}
+
+	SharedMsg::SharedMsg(SharedMsg&& other) noexcept
+		: m_block(other.m_block)
+	{
+		other.m_block = nullptr;
+	}
+
+	SharedMsg::SharedMsg(const SharedMsg& other) noexcept
+		: m_block(other.m_block)
+	{
+		if (m_block != nullptr)
+			m_block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	SharedMsg& SharedMsg::operator=(SharedMsg&& other) noexcept
+	{
+		if (&other != this)
+		{
+			release();
+			m_block = other.m_block;
+			other.m_block = nullptr;
+		}
+
+		return *this;
+	}
+
+	SharedMsg& SharedMsg::operator=(const SharedMsg& other) noexcept
+	{
+		Block* block = other.m_block;
+		if (block != nullptr)
+			block->refs.fetch_add(1, std::memory_order_relaxed);
+
+		release();
+		m_block = block;
+
+		return *this;
+	}
+
+	SharedMsg::~SharedMsg()
+	{
+		release();
+	}
+
+	const uint8_t* SharedMsg::buffer() const noexcept
+	{
+		return m_block != nullptr ? reinterpret_cast<const uint8_t*>(m_block) + sizeof(Block) : nullptr;
+	}
+
+	size_t SharedMsg::useCount() const noexcept
+	{
+		return m_block != nullptr ? m_block->refs.load(std::memory_order_relaxed) : 0;
+	}
+
+	void SharedMsg::release() noexcept
+	{
+		if (m_block == nullptr)
+			return;
+
+		// the last reference returns the buffer to the pool
+		if (m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			const size_t len = sizeof(Block) + m_block->length;
+			m_block->~Block();
+			MsgPool::Deleter{ len }(reinterpret_cast<uint8_t*>(m_block));
+		}
+
+		m_block = nullptr;
+	}
+}
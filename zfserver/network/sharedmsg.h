@@ -0,0 +1,107 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_NETWORK_SHARED_MSG_H
+#define ZFSERVER_NETWORK_SHARED_MSG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+
+namespace zfserver::network
+{
+	class Msg;
+
+	/**
+	 * Immutable serialized message, shared by many outbound queues.
+	 *
+	 * The bytes are copied once in a buffer of the MsgPool, prefixed by an intrusive
+	 * reference count. Copying a SharedMsg only increments the count, so a message
+	 * broadcast to many connections is serialized once. Each connection encrypts it
+	 * with its own cipher when the queue is flushed, into the destination buffer.
+	 */
+	class SharedMsg final
+	{
+	public:
+		/** Create an empty shared message. */
+		SharedMsg() noexcept = default;
+
+		/**
+		 * Create a shared message from a copy of the message.
+		 *
+		 * @param[in] msg  the message to copy
+		 */
+		explicit SharedMsg(const Msg& msg);
+
+		/**
+		 * Create a shared message from a copy of the buffer.
+		 *
+		 * @param[in] buf  the buffer to copy
+		 * @param[in] len  the length in bytes of the buffer
+		 */
+		SharedMsg(const uint8_t* buf, size_t len);
+
+		SharedMsg(SharedMsg&& other) noexcept;
+		SharedMsg(const SharedMsg& other) noexcept;
+		SharedMsg& operator=(SharedMsg&& other) noexcept;
+		SharedMsg& operator=(const SharedMsg& other) noexcept;
+
+		/** Release the reference, and the buffer with the last one. */
+		~SharedMsg();
+
+	public:
+		/** Get a pointer of the immutable buffer. */
+		[[nodiscard]] const uint8_t* buffer() const noexcept;
+
+		/** Get the length in bytes of the message. */
+		[[nodiscard]] size_t length() const noexcept { return m_block != nullptr ? m_block->length : 0; }
+
+		/** Get the number of references to the buffer. */
+		[[nodiscard]] size_t useCount() const noexcept;
+
+		/** Check whether the shared message holds a buffer. */
+		explicit operator bool() const noexcept { return m_block != nullptr; }
+
+	private:
+		/** The header of the buffer, followed by the message. */
+		struct Block
+		{
+			std::atomic<uint32_t> refs; //!< the number of references
+			uint32_t length; //!< the length in bytes of the message
+		};
+
+		/* release the reference to the block */
+		void release() noexcept;
+
+	private:
+		Block* m_block = nullptr; //!< the shared block (null when empty)
+	};
+}
+
+#endif // ZFSERVER_NETWORK_SHARED_MSG_H
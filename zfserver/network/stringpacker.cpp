@@ -34,8 +34,8 @@
 
 namespace zfserver::network
 {
-	StringPacker::StringPacker(uint8_t* buf)
-		: m_buffer(buf), m_count(*buf)
+	StringPacker::StringPacker(uint8_t* buf, const size_t len)
+		: m_buffer(buf), m_length(len), m_count(len != 0 ? *buf : 0)
 	{
 		assert(buf != nullptr);
 	}
@@ -44,12 +44,14 @@ namespace zfserver::network
 	{
 		assert(str.size() <= std::numeric_limits<uint8_t>::max());
 
-		char* ptr = reinterpret_cast<char*>(m_buffer + 1);
+		size_t offset = 1;
 		for (uint8_t i = 0; i < m_count; ++i)
-			ptr += *reinterpret_cast<uint8_t*>(ptr++); // the length...
+			offset += 1 + m_buffer[offset]; // the length...
 
-		*reinterpret_cast<uint8_t*>(ptr++) = static_cast<uint8_t>(str.size());
-		std::memcpy(ptr, str.data(), str.size());
+		assert(offset + 1 + str.size() <= m_length);
+
+		m_buffer[offset++] = static_cast<uint8_t>(str.size());
+		std::memcpy(m_buffer + offset, str.data(), str.size());
 
 		*m_buffer = ++m_count;
 	}
@@ -60,12 +62,13 @@ namespace zfserver::network
 
 		if (index < m_count)
 		{
-			char* ptr = reinterpret_cast<char*>(m_buffer + 1);
-			for (uint8_t i = 0; i < index; ++i)
-				ptr += *reinterpret_cast<uint8_t*>(ptr++); // the length...
+			size_t offset = 1;
+			for (uint8_t i = 0; i < index && offset < m_length; ++i)
+				offset += 1 + m_buffer[offset]; // the length...
 
-			uint8_t len = *reinterpret_cast<uint8_t*>(ptr++);
-			str = std::string_view{ ptr, len };
+			// the strings sent by the client might go past the end
+			if (offset < m_length && offset + 1 + m_buffer[offset] <= m_length)
+				str = std::string_view{ reinterpret_cast<const char*>(m_buffer + offset + 1), m_buffer[offset] };
 		}
 
 		return str;
@@ -42,6 +42,7 @@ namespace zfserver::network
 	 * their length in an unsigned 8-bit integer.
 	 *
 	 * When extracting string, the first string is at the index 0.
+	 * The strings are bounded by the length of the pack.
 	 */
 	class StringPacker final
 	{
@@ -50,8 +51,9 @@ namespace zfserver::network
 		 * Create a new packer around the specified buffer.
 		 *
 		 * @param buf[in]  the buffer of the string pack
+		 * @param len[in]  the length in bytes of the buffer
 		 */
-		StringPacker(uint8_t* buf);
+		StringPacker(uint8_t* buf, size_t len);
 
 		/* destructor */
 		~StringPacker() = default;
@@ -72,11 +74,14 @@ namespace zfserver::network
 		 * Extract a string from the pack.
 		 *
 		 * @param index[in]  the index of the string to retreive (0 is the first string)
+		 *
+		 * @returns the string, or nothing if missing or past the end of the pack
 		 */
 		std::optional<std::string_view> getString(uint8_t index) const;
 
 	private:
 		uint8_t* m_buffer; //!< reference to the internal buffer
+		size_t m_length; //!< the length in bytes of the buffer
 		uint8_t m_count; //!< the number of strings in the pack
 	};
 }
@@ -0,0 +1,142 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "ringbuffer.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+
+namespace zfserver
+{
+	uint8_t* RingBuffer::reserve(size_t len)
+	{
+		if (m_size + len > m_capacity)
+			grow(m_size + len);
+
+		size_t tail = (m_head + m_size) & (m_capacity - 1);
+		const bool wrapped = m_size != 0 && tail <= m_head;
+		const size_t contiguous = wrapped ? m_head - tail : m_capacity - tail;
+		if (contiguous < len)
+		{
+			// realign the bytes at the start, the free space is then contiguous
+			if (m_head + m_size <= m_capacity)
+			{
+				std::memmove(m_buffer.get(), m_buffer.get() + m_head, m_size);
+				m_head = 0;
+			}
+			else
+			{
+				grow(m_capacity);
+			}
+
+			tail = m_size;
+		}
+
+		m_size += len;
+		return m_buffer.get() + tail;
+	}
+
+	void RingBuffer::peek(size_t offset, uint8_t* dst, size_t len) const noexcept
+	{
+		assert(offset + len <= m_size);
+
+		if (len == 0)
+			return;
+
+		const size_t start = (m_head + offset) & (m_capacity - 1);
+		const size_t first = std::min(len, m_capacity - start);
+		std::memcpy(dst, m_buffer.get() + start, first);
+		std::memcpy(dst + first, m_buffer.get(), len - first);
+	}
+
+	uint8_t* RingBuffer::front(size_t len)
+	{
+		assert(len <= m_size);
+
+		if (len == 0)
+			return nullptr;
+
+		// realign the bytes at the start if they wrap
+		if (m_head + len > m_capacity)
+			grow(m_capacity);
+
+		return m_buffer.get() + m_head;
+	}
+
+	RingBuffer::Regions RingBuffer::regions(size_t offset, size_t len) noexcept
+	{
+		assert(offset + len <= m_size);
+
+		if (len == 0)
+			return { nullptr, 0, nullptr, 0 };
+
+		const size_t start = (m_head + offset) & (m_capacity - 1);
+		const size_t first = std::min(len, m_capacity - start);
+		return { m_buffer.get() + start, first, m_buffer.get(), len - first };
+	}
+
+	void RingBuffer::consume(size_t len) noexcept
+	{
+		assert(len <= m_size);
+
+		m_size -= len;
+		m_head = m_size != 0 ? (m_head + len) & (m_capacity - 1) : 0;
+	}
+
+	void RingBuffer::truncate(size_t len) noexcept
+	{
+		assert(len <= m_size);
+
+		m_size = len;
+		if (m_size == 0)
+			m_head = 0;
+	}
+
+	void RingBuffer::clear() noexcept
+	{
+		m_head = 0;
+		m_size = 0;
+	}
+
+	void RingBuffer::grow(size_t capacity)
+	{
+		size_t newCapacity = std::max(m_capacity, MIN_CAPACITY);
+		while (newCapacity < capacity)
+			newCapacity *= 2;
+
+		auto buffer = std::make_unique<uint8_t[]>(newCapacity);
+		if (m_size != 0)
+			peek(0, buffer.get(), m_size);
+
+		m_buffer = std::move(buffer);
+		m_capacity = newCapacity;
+		m_head = 0;
+	}
+}
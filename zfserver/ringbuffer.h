@@ -0,0 +1,102 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_RING_BUFFER_H
+#define ZFSERVER_RING_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+
+namespace zfserver
+{
+	// Growable byte ring buffer. The capacity is a power of two, and the
+	// buffer grows (keeping the bytes in order) when a write doesn't fit.
+	class RingBuffer final
+	{
+	public:
+		// the initial capacity, on the first write
+		static constexpr size_t MIN_CAPACITY = 4096;
+
+		// up to two contiguous regions, in the order of the bytes
+		struct Regions
+		{
+			uint8_t* first;
+			size_t firstLength;
+			uint8_t* second;
+			size_t secondLength;
+		};
+
+	public:
+		RingBuffer() = default;
+		~RingBuffer() = default;
+
+		RingBuffer(RingBuffer&& other) = delete;
+		RingBuffer(const RingBuffer& other) = delete;
+		RingBuffer& operator=(RingBuffer&& other) = delete;
+		RingBuffer& operator=(const RingBuffer& other) = delete;
+
+		size_t size() const noexcept { return m_size; }
+		size_t capacity() const noexcept { return m_capacity; }
+		bool empty() const noexcept { return m_size == 0; }
+
+		// appends len contiguous bytes at the end, and returns them to be filled
+		uint8_t* reserve(size_t len);
+
+		// copies len bytes starting at offset (from the first byte), without consuming them
+		void peek(size_t offset, uint8_t* dst, size_t len) const noexcept;
+
+		// gets the first len bytes contiguously (realigning them if they wrap), to be used in-place
+		uint8_t* front(size_t len);
+
+		// gets the regions of len bytes starting at offset (from the first byte), to be used in-place
+		Regions regions(size_t offset, size_t len) noexcept;
+
+		// drops the first len bytes
+		void consume(size_t len) noexcept;
+
+		// drops the bytes after the first len
+		void truncate(size_t len) noexcept;
+
+		// drops all the bytes, keeping the capacity
+		void clear() noexcept;
+
+	private:
+		// grows the buffer to hold at least the capacity, with the bytes at the start
+		void grow(size_t capacity);
+
+	private:
+		std::unique_ptr<uint8_t[]> m_buffer = nullptr;
+		size_t m_capacity = 0; // always a power of two (or 0)
+		size_t m_head = 0; // the index of the first byte
+		size_t m_size = 0; // the number of bytes
+	};
+}
+
+#endif // ZFSERVER_RING_BUFFER_H
@@ -0,0 +1,143 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "parallelencryptor.h"
+#include "tqcipher.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+namespace zfserver::security
+{
+	ParallelEncryptor& ParallelEncryptor::instance()
+	{
+		// never destroyed, joining threads while the DLL is unloading would deadlock
+		static ParallelEncryptor* encryptor = new ParallelEncryptor(
+			std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U) - 1, MAX_WORKERS));
+		return *encryptor;
+	}
+
+	ParallelEncryptor::ParallelEncryptor(size_t workers)
+	{
+		m_workers.reserve(workers);
+		for (size_t i = 0; i != workers; ++i)
+			m_workers.emplace_back(&ParallelEncryptor::work, this);
+	}
+
+	ParallelEncryptor::~ParallelEncryptor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wakeUp.notify_all();
+
+		for (auto& worker : m_workers)
+			worker.join();
+	}
+
+	void ParallelEncryptor::encrypt(TqCipher& cipher, const Span* spans, size_t count)
+	{
+		assert(spans != nullptr || count == 0);
+
+		size_t total = 0;
+		for (size_t i = 0; i != count; ++i)
+			total += spans[i].len;
+
+		if (m_workers.empty() || total < MIN_PARALLEL_LENGTH)
+		{
+			for (size_t i = 0; i != count; ++i)
+				cipher.encrypt(spans[i].src, spans[i].dst, spans[i].len);
+			return;
+		}
+
+		// split the spans in chunks, each at its own position in the stream
+		m_jobs.clear();
+		uint16_t counter = cipher.encryptCounter();
+		for (size_t i = 0; i != count; ++i)
+		{
+			const Span& span = spans[i];
+			for (size_t offset = 0; offset < span.len; offset += CHUNK_SIZE)
+			{
+				const size_t len = std::min(CHUNK_SIZE, span.len - offset);
+				m_jobs.push_back({ span.src + offset, span.dst + offset, len, counter });
+				counter = static_cast<uint16_t>(counter + len);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_cipher = &cipher;
+			m_nextJob = 0;
+			m_active = m_workers.size();
+			++m_generation;
+		}
+		m_wakeUp.notify_all();
+
+		// the calling thread takes its share of the chunks
+		runJobs();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_active == 0; });
+		m_cipher = nullptr;
+
+		cipher.skipEncrypt(total);
+	}
+
+	void ParallelEncryptor::work()
+	{
+		uint64_t generation = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeUp.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+				if (m_stopping)
+					return;
+
+				generation = m_generation;
+			}
+
+			runJobs();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_active == 0)
+				m_done.notify_one();
+		}
+	}
+
+	void ParallelEncryptor::runJobs() noexcept
+	{
+		for (size_t i = m_nextJob++; i < m_jobs.size(); i = m_nextJob++)
+		{
+			const Job& job = m_jobs[i];
+			m_cipher->encryptAt(job.counter, job.src, job.dst, job.len);
+		}
+	}
+}
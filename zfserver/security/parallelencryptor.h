@@ -0,0 +1,141 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_SECURITY_PARALLEL_ENCRYPTOR_H
+#define ZFSERVER_SECURITY_PARALLEL_ENCRYPTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zfserver::security
+{
+	class TqCipher;
+
+	/**
+	 * @brief Parallel TQ Cipher encryptor
+	 *
+	 * Encrypts large outbound batches on a pool of worker threads. As the keystream
+	 * only depends on the position in the stream, the batch is split into chunks
+	 * which are encrypted independently with TqCipher::encryptAt.
+	 *
+	 * @remarks Small batches are encrypted on the calling thread.
+	 */
+	class ParallelEncryptor final
+	{
+	public:
+		/** The minimum length (in bytes) of a batch to be split on the workers. */
+		static constexpr size_t MIN_PARALLEL_LENGTH = 16 * 1024;
+		/** The length (in bytes) of the chunks given to the workers. */
+		static constexpr size_t CHUNK_SIZE = 4 * 1024;
+		/** The maximum number of workers (the game still needs its threads). */
+		static constexpr size_t MAX_WORKERS = 4;
+
+		/**
+		 * @brief A part of the batch, encrypted from src to dst.
+		 */
+		struct Span
+		{
+			const uint8_t* src;
+			uint8_t* dst;
+			size_t len;
+		};
+
+	public:
+		/**
+		 * @brief Gets the shared encryptor, creating its workers on first use.
+		 */
+		static ParallelEncryptor& instance();
+
+	public:
+		/**
+		 * @brief Creates a new encryptor.
+		 *
+		 * @param[in]  workers  The number of worker threads.
+		 */
+		explicit ParallelEncryptor(size_t workers);
+
+		/* destructor */
+		~ParallelEncryptor();
+
+		ParallelEncryptor(ParallelEncryptor&&) = delete;
+		ParallelEncryptor(const ParallelEncryptor&) = delete;
+		ParallelEncryptor& operator=(ParallelEncryptor&&) = delete;
+		ParallelEncryptor& operator=(const ParallelEncryptor&) = delete;
+
+		/**
+		 * @brief Encrypts the spans as one contiguous part of the stream.
+		 *
+		 * @param[in,out]  cipher  The cipher, its encryption counter is advanced.
+		 * @param[in]      spans   The spans to encrypt, in the order of the stream.
+		 * @param[in]      count   The number of spans.
+		 *
+		 * @remarks The spans must not overlap each other. Must not be called concurrently.
+		 */
+		void encrypt(TqCipher& cipher, const Span* spans, size_t count);
+
+	private:
+		/**
+		 * @brief A chunk of a span, at its position in the stream.
+		 */
+		struct Job
+		{
+			const uint8_t* src;
+			uint8_t* dst;
+			size_t len;
+			uint16_t counter;
+		};
+
+		/* the loop of the worker threads */
+		void work();
+
+		/* executes the jobs until none remains */
+		void runJobs() noexcept;
+
+	private:
+		std::vector<std::thread> m_workers; //!< the worker threads
+
+		std::mutex m_mutex; //!< protects the state of the batch
+		std::condition_variable m_wakeUp; //!< signaled when a batch starts (or on stop)
+		std::condition_variable m_done; //!< signaled when the last worker is done
+		uint64_t m_generation = 0; //!< the number of batches started
+		size_t m_active = 0; //!< the number of workers still on the batch
+		bool m_stopping = false; //!< whether the workers must exit
+
+		const TqCipher* m_cipher = nullptr; //!< the cipher of the batch
+		std::vector<Job> m_jobs; //!< the chunks of the batch
+		std::atomic<size_t> m_nextJob = { 0 }; //!< the index of the next chunk to take
+	};
+}
+
+#endif // ZFSERVER_SECURITY_PARALLEL_ENCRYPTOR_H
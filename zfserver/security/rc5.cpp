@@ -26,13 +26,9 @@
 //  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 
-#include "rc5.h"
+#include "rc5_kernels.h"
 
-#include <cassert>
-#include <cstring>
-
-#include <algorithm>
-#include <type_traits>
+#include "cpu.h"
 
 namespace zfserver::security
 {
@@ -41,96 +37,94 @@ namespace zfserver::security
 		inline uint32_t rotl(uint32_t value, uint32_t count)
 		{
 			count %= 32;
-			return (value >> (32 - count)) | (value << count);
+			return (value << count) | (value >> ((32 - count) % 32));
 		}
 
 		inline uint32_t rotr(uint32_t value, uint32_t count)
 		{
 			count %= 32;
-			return (value >> count) | (value << (32 - count));
+			return (value >> count) | (value << ((32 - count) % 32));
 		}
 	}
 
-	RC5::RC5(const uint8_t seed[KEY_SIZE]) noexcept
-	{
-		generateKey(seed);
-	}
-
-	void RC5::generateKey(const uint8_t seed[KEY_SIZE]) noexcept
+	namespace rc5
 	{
-		assert(seed != nullptr);
-
-		static constexpr uint32_t PW32 = std::integral_constant<uint32_t, 0xB7E15163>::value;
-		static constexpr uint32_t QW32 = std::integral_constant<uint32_t, 0x9E3779B9>::value;
-
-		uint32_t key[KEY32_SIZE];
-		std::memcpy(key, seed, KEY_SIZE);
-
-		size_t i, j;
-		uint32_t x, y;
-
-		m_sub[0] = PW32;
-		for (i = 1; i < SUB32_SIZE; ++i)
-			m_sub[i] = m_sub[i - 1] + QW32;
-
-		i = j = 0;
-		x = y = 0;
-		for (size_t k = 0, size = 3 * std::max(KEY32_SIZE, SUB32_SIZE); k < size; ++k)
+		namespace
 		{
-			m_sub[i] = rotl((m_sub[i] + x + y), 3);
-			x = m_sub[i];
-			i = (i + 1) % SUB32_SIZE;
-			key[j] = rotl((key[j] + x + y), (x + y));
-			y = key[j];
-			j = (j + 1) % KEY32_SIZE;
+			bool isAlwaysSupported() noexcept
+			{
+				return true;
+			}
 		}
-	}
 
-	void RC5::encrypt(uint8_t* buf, size_t len) noexcept
-	{
-		assert(buf != nullptr);
-		assert(len % BLOCK_SIZE == 0);
+		const Kernel KERNELS[KERNEL_COUNT] = {
+			{ "avx2", &cpu::hasAVX2, 8, &avx2::encrypt, &avx2::decrypt },
+			{ "scalar", &isAlwaysSupported, 1, &scalar::encrypt, &scalar::decrypt },
+		};
 
-		uint32_t* block = reinterpret_cast<uint32_t*>(buf);
-		for (size_t i = 0, bc = len / BLOCK_SIZE; i != bc; ++i)
+		namespace
 		{
-			uint32_t a = block[2 * i];
-			uint32_t b = block[2 * i + 1];
-
-			uint32_t le = a + m_sub[0];
-			uint32_t re = b + m_sub[1];
-			for (size_t j = 1; j <= ROUNDS; ++j)
+			const Kernel& selectKernel() noexcept
 			{
-				le = rotl((le ^ re), re) + m_sub[2 * j];
-				re = rotl((re ^ le), le) + m_sub[2 * j + 1];
+				for (const auto& kernel : KERNELS)
+				{
+					if (kernel.isSupported())
+						return kernel;
+				}
+
+				return KERNELS[KERNEL_COUNT - 1];
 			}
 
-			block[2 * i] = le;
-			block[2 * i + 1] = re;
+			// selected once at startup
+			const Kernel& s_kernel = selectKernel();
 		}
-	}
 
-	void RC5::decrypt(uint8_t* buf, size_t len) noexcept
-	{
-		assert(buf != nullptr);
-		assert(len % BLOCK_SIZE == 0);
-
-		uint32_t* block = reinterpret_cast<uint32_t*>(buf);
-		for (size_t i = 0, bc = len / BLOCK_SIZE; i != bc; ++i)
+		const Kernel& kernel() noexcept
 		{
-			uint32_t ld = block[2 * i];
-			uint32_t rd = block[2 * i + 1];
+			return s_kernel;
+		}
 
-			for (size_t j = ROUNDS; j >= 1; --j)
+		namespace scalar
+		{
+			void encrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept
 			{
-				rd = rotr((rd - m_sub[2 * j + 1]), ld) ^ ld;
-				ld = rotr((ld - m_sub[2 * j]), rd) ^ rd;
+				for (size_t i = 0; i != count; ++i)
+				{
+					uint32_t a = blocks[2 * i];
+					uint32_t b = blocks[2 * i + 1];
+
+					uint32_t le = a + sub[0];
+					uint32_t re = b + sub[1];
+					for (size_t j = 1; j <= rounds; ++j)
+					{
+						le = rotl((le ^ re), re) + sub[2 * j];
+						re = rotl((re ^ le), le) + sub[2 * j + 1];
+					}
+
+					blocks[2 * i] = le;
+					blocks[2 * i + 1] = re;
+				}
 			}
-			uint32_t a = ld - m_sub[0];
-			uint32_t b = rd - m_sub[1];
 
-			block[2 * i] = a;
-			block[2 * i + 1] = b;
+			void decrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept
+			{
+				for (size_t i = 0; i != count; ++i)
+				{
+					uint32_t ld = blocks[2 * i];
+					uint32_t rd = blocks[2 * i + 1];
+
+					for (size_t j = rounds; j >= 1; --j)
+					{
+						rd = rotr((rd - sub[2 * j + 1]), ld) ^ ld;
+						ld = rotr((ld - sub[2 * j]), rd) ^ rd;
+					}
+					uint32_t a = ld - sub[0];
+					uint32_t b = rd - sub[1];
+
+					blocks[2 * i] = a;
+					blocks[2 * i + 1] = b;
+				}
+			}
 		}
 	}
 }
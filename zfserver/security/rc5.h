@@ -29,8 +29,17 @@
 #ifndef ZFSERVER_SECURITY_RC5_H
 #define ZFSERVER_SECURITY_RC5_H
 
+#include "rc5_kernels.h"
+
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace zfserver::security
 {
@@ -48,32 +57,50 @@ namespace zfserver::security
      * 12-round RC5 (with 64-bit blocks) is susceptible to a differential attack
      * using 2 ^ 44 chosen plaintexts. To be still an effective cipher, 18-20 rounds
      * are now suggested.
+     *
+     * The key schedule is constexpr, so a cipher with a constant seed can be
+     * generated at compile-time. The rounds are unrolled for the fixed number of
+     * rounds. The 32-bit word version uses the SIMD kernel selected at startup
+     * when there are enough blocks to fill its lanes.
+     *
+     * @tparam Word     The type of a word (uint16_t, uint32_t or uint64_t), half a block.
+     * @tparam Rounds   The number of round of the algorithm.
+     * @tparam KeySize  The size (in bytes) of the key.
      */
-    class RC5 final
+    template<typename Word, size_t Rounds, size_t KeySize>
+    class BasicRC5 final
     {
+        static_assert(std::is_same_v<Word, uint16_t> || std::is_same_v<Word, uint32_t> || std::is_same_v<Word, uint64_t>,
+                      "The word must be a 16, 32 or 64 bits unsigned integer.");
+        static_assert(Rounds >= 1 && Rounds <= 255, "The number of rounds must be between 1 and 255.");
+        static_assert(KeySize <= 255, "The key must be at most 255 bytes.");
+
     public:
         /** The size (in bytes) of the key. (0 - 255, 16 suggested) */
-        static const size_t KEY_SIZE = 16;
+        static constexpr size_t KEY_SIZE = KeySize;
         /** The size (in bytes) of the blocks, (4, 8 or 16, 8 suggested) */
-        static const size_t BLOCK_SIZE = 8;
+        static constexpr size_t BLOCK_SIZE = 2 * sizeof(Word);
         /** The number of round of the algorithm (1 - 255, 12 suggested) */
-        static const size_t ROUNDS = 12;
+        static constexpr size_t ROUNDS = Rounds;
 
     public:
         /**
          * @brief Creates a new uninitialized RC5 cipher.
          */
-        RC5() noexcept = default;
+        constexpr BasicRC5() noexcept = default;
 
         /**
          * @brief Creates a new RC5 cipher and generates the key.
          *
          * @param[in]  seed  The seed to use to generate the key.
          */
-        RC5(const uint8_t seed[KEY_SIZE]) noexcept;
+        constexpr BasicRC5(const uint8_t seed[KEY_SIZE]) noexcept
+        {
+            generateKey(seed);
+        }
 
         /* destructor */
-        ~RC5() = default;
+        ~BasicRC5() = default;
 
     public:
         /**
@@ -81,7 +108,31 @@ namespace zfserver::security
          *
          * @param[in]  seed  The seed to use to generate the key.
          */
-        void generateKey(const uint8_t seed[KEY_SIZE]) noexcept;
+        constexpr void generateKey(const uint8_t seed[KEY_SIZE]) noexcept
+        {
+            assert(seed != nullptr || KEY_SIZE == 0);
+
+            // the key is loaded as little-endian words
+            Word key[KEY_WORDS] = {};
+            for (size_t i = KEY_SIZE; i != 0; --i)
+                key[(i - 1) / sizeof(Word)] = static_cast<Word>((key[(i - 1) / sizeof(Word)] << 8) | seed[i - 1]);
+
+            m_sub[0] = P;
+            for (size_t i = 1; i < SUB_SIZE; ++i)
+                m_sub[i] = static_cast<Word>(m_sub[i - 1] + Q);
+
+            size_t i = 0, j = 0;
+            Word x = 0, y = 0;
+            for (size_t k = 0, size = 3 * std::max(KEY_WORDS, SUB_SIZE); k < size; ++k)
+            {
+                m_sub[i] = rotl(static_cast<Word>(m_sub[i] + x + y), 3);
+                x = m_sub[i];
+                i = (i + 1) % SUB_SIZE;
+                key[j] = rotl(static_cast<Word>(key[j] + x + y), static_cast<Word>(x + y));
+                y = key[j];
+                j = (j + 1) % KEY_WORDS;
+            }
+        }
 
         /**
          * @brief Encrypts the buffer.
@@ -92,7 +143,29 @@ namespace zfserver::security
          * @remarks The encryption is done in-place.
          * @remarks The length must be a multiple of the BLOCK_SIZE.
          */
-        void encrypt(uint8_t* buf, size_t len) noexcept;
+        void encrypt(uint8_t* buf, size_t len) const noexcept
+        {
+            assert(buf != nullptr);
+            assert(len % BLOCK_SIZE == 0);
+
+            if constexpr (HAS_KERNEL)
+            {
+                const rc5::Kernel& kernel = rc5::kernel();
+                if (kernel.lanes > 1 && len / BLOCK_SIZE >= kernel.lanes)
+                {
+                    kernel.encrypt(m_sub, ROUNDS, reinterpret_cast<uint32_t*>(buf), len / BLOCK_SIZE);
+                    return;
+                }
+            }
+
+            for (size_t i = 0; i != len; i += BLOCK_SIZE)
+            {
+                Word block[2];
+                std::memcpy(block, buf + i, BLOCK_SIZE);
+                encryptBlock(block[0], block[1], std::make_index_sequence<ROUNDS>{});
+                std::memcpy(buf + i, block, BLOCK_SIZE);
+            }
+        }
 
         /**
          * @brief Decrypts the buffer.
@@ -103,22 +176,201 @@ namespace zfserver::security
          * @remarks The decryption is done in-place.
          * @remarks The length must be a multiple of the BLOCK_SIZE.
          */
-        void decrypt(uint8_t* buf, size_t len) noexcept;
+        void decrypt(uint8_t* buf, size_t len) const noexcept
+        {
+            assert(buf != nullptr);
+            assert(len % BLOCK_SIZE == 0);
+
+            if constexpr (HAS_KERNEL)
+            {
+                const rc5::Kernel& kernel = rc5::kernel();
+                if (kernel.lanes > 1 && len / BLOCK_SIZE >= kernel.lanes)
+                {
+                    kernel.decrypt(m_sub, ROUNDS, reinterpret_cast<uint32_t*>(buf), len / BLOCK_SIZE);
+                    return;
+                }
+            }
+
+            for (size_t i = 0; i != len; i += BLOCK_SIZE)
+            {
+                Word block[2];
+                std::memcpy(block, buf + i, BLOCK_SIZE);
+                decryptBlock(block[0], block[1], std::make_index_sequence<ROUNDS>{});
+                std::memcpy(buf + i, block, BLOCK_SIZE);
+            }
+        }
+
+        /**
+         * @brief Encrypts many buffers of the same length.
+         *
+         * @param[in]  bufs   The buffers to encrypt.
+         * @param[in]  count  The number of buffers.
+         * @param[in]  len    The length (in bytes) of each buffer.
+         *
+         * @remarks The encryption is done in-place.
+         * @remarks The blocks of all the buffers are processed together, so the SIMD
+         *          lanes stay full with short buffers (e.g. the passwords of many logins).
+         */
+        void encrypt(uint8_t* const bufs[], size_t count, size_t len) const noexcept
+        {
+            if constexpr (HAS_KERNEL)
+            {
+                process(rc5::kernel().encrypt, bufs, count, len);
+            }
+            else
+            {
+                for (size_t i = 0; i != count; ++i)
+                    encrypt(bufs[i], len);
+            }
+        }
+
+        /**
+         * @brief Decrypts many buffers of the same length.
+         *
+         * @param[in]  bufs   The buffers to decrypt.
+         * @param[in]  count  The number of buffers.
+         * @param[in]  len    The length (in bytes) of each buffer.
+         *
+         * @remarks The decryption is done in-place.
+         * @remarks The blocks of all the buffers are processed together, so the SIMD
+         *          lanes stay full with short buffers (e.g. the passwords of many logins).
+         */
+        void decrypt(uint8_t* const bufs[], size_t count, size_t len) const noexcept
+        {
+            if constexpr (HAS_KERNEL)
+            {
+                process(rc5::kernel().decrypt, bufs, count, len);
+            }
+            else
+            {
+                for (size_t i = 0; i != count; ++i)
+                    decrypt(bufs[i], len);
+            }
+        }
 
     private:
         /**
-         * @brief The size (in 32 bits block) of the key.
+         * @brief Rotates the value to the left.
+         *
+         * @remarks Only the low bits of the count are used, a count of 0 is fine.
+         */
+        static constexpr Word rotl(Word value, Word count) noexcept
+        {
+            count %= BITS;
+            return static_cast<Word>((value << count) | (value >> ((BITS - count) % BITS)));
+        }
+
+        /**
+         * @brief Rotates the value to the right.
+         *
+         * @remarks Only the low bits of the count are used, a count of 0 is fine.
+         */
+        static constexpr Word rotr(Word value, Word count) noexcept
+        {
+            count %= BITS;
+            return static_cast<Word>((value >> count) | (value << ((BITS - count) % BITS)));
+        }
+
+        /**
+         * @brief Encrypts one block, with all the rounds unrolled.
          */
-        static constexpr size_t KEY32_SIZE = KEY_SIZE / sizeof(uint32_t);
+        template<size_t... I>
+        constexpr void encryptBlock(Word& a, Word& b, std::index_sequence<I...>) const noexcept
+        {
+            a = static_cast<Word>(a + m_sub[0]);
+            b = static_cast<Word>(b + m_sub[1]);
+            ((a = static_cast<Word>(rotl(static_cast<Word>(a ^ b), b) + m_sub[2 * I + 2]),
+              b = static_cast<Word>(rotl(static_cast<Word>(b ^ a), a) + m_sub[2 * I + 3])), ...);
+        }
 
         /**
-         * @brief The size (in 32 bits block) of the sub key.
+         * @brief Decrypts one block, with all the rounds unrolled.
          */
-        static constexpr size_t SUB32_SIZE = ((ROUNDS * 2) + 2);
+        template<size_t... I>
+        constexpr void decryptBlock(Word& a, Word& b, std::index_sequence<I...>) const noexcept
+        {
+            ((b = static_cast<Word>(rotr(static_cast<Word>(b - m_sub[2 * (ROUNDS - I) + 1]), a) ^ a),
+              a = static_cast<Word>(rotr(static_cast<Word>(a - m_sub[2 * (ROUNDS - I)]), b) ^ b)), ...);
+            a = static_cast<Word>(a - m_sub[0]);
+            b = static_cast<Word>(b - m_sub[1]);
+        }
+
+        /**
+         * @brief Gathers the blocks of many buffers, and processes them with the kernel.
+         */
+        void process(rc5::BlocksFn fn, uint8_t* const bufs[], size_t count, size_t len) const noexcept
+        {
+            assert(bufs != nullptr || count == 0);
+            assert(len % BLOCK_SIZE == 0);
+
+            // the blocks of many buffers are gathered to fill the lanes of the kernel
+            uint32_t blocks[MULTI_BUFFER_BLOCKS * BLOCK_SIZE / sizeof(uint32_t)];
+
+            const size_t buffersPerBatch = std::max<size_t>(1, sizeof(blocks) / std::max<size_t>(len, 1));
+            for (size_t first = 0; first < count; first += buffersPerBatch)
+            {
+                const size_t last = std::min(count, first + buffersPerBatch);
+                if (len > sizeof(blocks))
+                {
+                    // large buffers already fill the lanes
+                    assert(last == first + 1);
+                    fn(m_sub, ROUNDS, reinterpret_cast<uint32_t*>(bufs[first]), len / BLOCK_SIZE);
+                    continue;
+                }
+
+                uint8_t* staging = reinterpret_cast<uint8_t*>(blocks);
+                for (size_t i = first; i != last; ++i)
+                    std::memcpy(staging + (i - first) * len, bufs[i], len);
+
+                fn(m_sub, ROUNDS, blocks, (last - first) * len / BLOCK_SIZE);
+
+                for (size_t i = first; i != last; ++i)
+                    std::memcpy(bufs[i], staging + (i - first) * len, len);
+            }
+        }
 
     private:
-        uint32_t m_sub[SUB32_SIZE]; //!< The generated sub key.
+        /** Whether a SIMD kernel exists for the version of the cipher. */
+        static constexpr bool HAS_KERNEL = std::is_same_v<Word, uint32_t>;
+
+        /**
+         * @brief The size (in bits) of a word.
+         */
+        static constexpr Word BITS = std::numeric_limits<Word>::digits;
+
+        /**
+         * @brief The size (in words) of the key.
+         */
+        static constexpr size_t KEY_WORDS = std::max<size_t>(1, (KEY_SIZE + sizeof(Word) - 1) / sizeof(Word));
+
+        /**
+         * @brief The size (in words) of the sub key.
+         */
+        static constexpr size_t SUB_SIZE = ((ROUNDS * 2) + 2);
+
+        /**
+         * @brief The number of blocks gathered by the multi-buffer API.
+         */
+        static constexpr size_t MULTI_BUFFER_BLOCKS = 64;
+
+        /**
+         * @brief The magic constant P (Odd((e - 2) * 2 ^ w)) of the key schedule.
+         */
+        static constexpr Word P = static_cast<Word>((0xB7E151628AED2A6BULL >> (64 - BITS)) | 1);
+
+        /**
+         * @brief The magic constant Q (Odd((phi - 1) * 2 ^ w)) of the key schedule.
+         */
+        static constexpr Word Q = static_cast<Word>((0x9E3779B97F4A7C15ULL >> (64 - BITS)) | 1);
+
+    private:
+        Word m_sub[SUB_SIZE] = {}; //!< The generated sub key.
     };
+
+    /**
+     * @brief RC5-32/12/16, the version of the cipher used by the game.
+     */
+    using RC5 = BasicRC5<uint32_t, 12, 16>;
 }
 
 #endif // ZFSERVER_SECURITY_RC5_H
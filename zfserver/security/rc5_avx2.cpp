@@ -0,0 +1,121 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "rc5_kernels.h"
+
+#include <immintrin.h>
+
+// Compiled with AVX2 enabled (/arch:AVX2)
+
+namespace zfserver::security::rc5::avx2
+{
+	namespace
+	{
+		/** The number of blocks per lane group (8 words A, 8 words B). */
+		constexpr size_t LANES = 8;
+
+		inline __m256i rotl(__m256i value, __m256i count) noexcept
+		{
+			// a shift by 32 gives 0, so a count of 0 is fine
+			count = _mm256_and_si256(count, _mm256_set1_epi32(31));
+			return _mm256_or_si256(
+				_mm256_sllv_epi32(value, count),
+				_mm256_srlv_epi32(value, _mm256_sub_epi32(_mm256_set1_epi32(32), count)));
+		}
+
+		inline __m256i rotr(__m256i value, __m256i count) noexcept
+		{
+			// a shift by 32 gives 0, so a count of 0 is fine
+			count = _mm256_and_si256(count, _mm256_set1_epi32(31));
+			return _mm256_or_si256(
+				_mm256_srlv_epi32(value, count),
+				_mm256_sllv_epi32(value, _mm256_sub_epi32(_mm256_set1_epi32(32), count)));
+		}
+
+		/** Splits 8 blocks in the A and B words (in the same, shuffled, order). */
+		inline void load(const uint32_t* blocks, __m256i& a, __m256i& b) noexcept
+		{
+			const __m256 lo = _mm256_loadu_ps(reinterpret_cast<const float*>(blocks));
+			const __m256 hi = _mm256_loadu_ps(reinterpret_cast<const float*>(blocks + LANES));
+
+			a = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			b = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+
+		/** Interleaves back the A and B words of 8 blocks. */
+		inline void store(uint32_t* blocks, __m256i a, __m256i b) noexcept
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks), _mm256_unpacklo_epi32(a, b));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks + LANES), _mm256_unpackhi_epi32(a, b));
+		}
+	}
+
+	void encrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept
+	{
+		size_t i = 0;
+		for (; i + LANES <= count; i += LANES)
+		{
+			__m256i a, b;
+			load(blocks + 2 * i, a, b);
+
+			__m256i le = _mm256_add_epi32(a, _mm256_set1_epi32(static_cast<int>(sub[0])));
+			__m256i re = _mm256_add_epi32(b, _mm256_set1_epi32(static_cast<int>(sub[1])));
+			for (size_t j = 1; j <= rounds; ++j)
+			{
+				le = _mm256_add_epi32(rotl(_mm256_xor_si256(le, re), re), _mm256_set1_epi32(static_cast<int>(sub[2 * j])));
+				re = _mm256_add_epi32(rotl(_mm256_xor_si256(re, le), le), _mm256_set1_epi32(static_cast<int>(sub[2 * j + 1])));
+			}
+
+			store(blocks + 2 * i, le, re);
+		}
+
+		scalar::encrypt(sub, rounds, blocks + 2 * i, count - i);
+	}
+
+	void decrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept
+	{
+		size_t i = 0;
+		for (; i + LANES <= count; i += LANES)
+		{
+			__m256i ld, rd;
+			load(blocks + 2 * i, ld, rd);
+
+			for (size_t j = rounds; j >= 1; --j)
+			{
+				rd = _mm256_xor_si256(rotr(_mm256_sub_epi32(rd, _mm256_set1_epi32(static_cast<int>(sub[2 * j + 1]))), ld), ld);
+				ld = _mm256_xor_si256(rotr(_mm256_sub_epi32(ld, _mm256_set1_epi32(static_cast<int>(sub[2 * j]))), rd), rd);
+			}
+
+			const __m256i a = _mm256_sub_epi32(ld, _mm256_set1_epi32(static_cast<int>(sub[0])));
+			const __m256i b = _mm256_sub_epi32(rd, _mm256_set1_epi32(static_cast<int>(sub[1])));
+			store(blocks + 2 * i, a, b);
+		}
+
+		scalar::decrypt(sub, rounds, blocks + 2 * i, count - i);
+	}
+}
@@ -0,0 +1,88 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_SECURITY_RC5_KERNELS_H
+#define ZFSERVER_SECURITY_RC5_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Internal header of the RC5 cipher. Each SIMD kernel lives in its own translation
+// unit compiled for its instruction set. The kernel is selected at runtime.
+//
+// All kernels process count blocks of two 32 bits words (A, B) in-place, with the
+// sub key of a RC5-32 cipher using the specified number of rounds.
+
+namespace zfserver::security::rc5
+{
+	/** Processes the blocks with the sub key. */
+	using BlocksFn = void (*)(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept;
+
+	/**
+	 * A set of kernels targeting an instruction set.
+	 */
+	struct Kernel
+	{
+		/** The name of the instruction set */
+		const char* name;
+		/** Whether the host supports the instruction set */
+		bool (*isSupported)() noexcept;
+		/** The number of blocks processed together */
+		size_t lanes;
+
+		BlocksFn encrypt;
+		BlocksFn decrypt;
+	};
+
+	/** The number of kernels. */
+	constexpr size_t KERNEL_COUNT = 2;
+
+	/**
+	 * All the kernels, from the fastest to the slowest (including the ones the host doesn't support).
+	 */
+	extern const Kernel KERNELS[KERNEL_COUNT];
+
+	/**
+	 * The kernel selected at startup.
+	 */
+	const Kernel& kernel() noexcept;
+
+	namespace scalar
+	{
+		void encrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept;
+		void decrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept;
+	}
+
+	namespace avx2
+	{
+		void encrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept;
+		void decrypt(const uint32_t* sub, size_t rounds, uint32_t* blocks, size_t count) noexcept;
+	}
+}
+
+#endif // ZFSERVER_SECURITY_RC5_KERNELS_H
@@ -27,100 +27,185 @@
 //
 
 #include "tqcipher.h"
+#include "tqcipher_kernels.h"
+
+#include "cpu.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 
-#include <type_traits>
-
-#if defined(__AVX2__)
-#   define _vector_load(p)         _mm256_load_si256(p)
-#   define _vector_loadu(p)        _mm256_loadu_si256(p)
-#   define _vector_storeu(p, b)    _mm256_storeu_si256(p, b)
-#   define _vector_set1_epi8(val)  _mm256_set1_epi8(val)
-#   define _vector_xor(a, b)       _mm256_xor_si256(a, b)
-#   define _vector_or(a, b)        _mm256_or_si256(a, b)
-#   define _vector_slli_epi8(a, c) _mm256_slli_epi8(a, c)
-#   define _vector_srli_epi8(a, c) _mm256_srli_epi8(a, c)
-#elif defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-#   define _vector_load(p)         _mm_load_si128(p)
-#   define _vector_loadu(p)        _mm_loadu_si128(p)
-#   define _vector_storeu(p, b)    _mm_storeu_si128(p, b)
-#   define _vector_set1_epi8(val)  _mm_set1_epi8(val)
-#   define _vector_xor(a, b)       _mm_xor_si128(a, b)
-#   define _vector_or(a, b)        _mm_or_si128(a, b)
-#   define _vector_slli_epi8(a, c) _mm_slli_epi8(a, c)
-#   define _vector_srli_epi8(a, c) _mm_srli_epi8(a, c)
-#endif
+#include <algorithm>
 
 namespace zfserver::security
 {
-	namespace
+	namespace tqcipher
 	{
-#if defined(__AVX2__)
-		__forceinline __m256i _mm256_slli_epi8(__m256i __a, int __count)
+		namespace
 		{
-			static constexpr uint8_t MASKS[] = { 0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80 };
-			return _mm256_and_si256(_mm256_slli_epi16(__a, __count), _mm256_set1_epi8(MASKS[__count]));
+			bool isAlwaysSupported() noexcept
+			{
+				return true;
+			}
+
+			bool isAVX512Supported() noexcept
+			{
+				return cpu::hasAVX512BW() && cpu::hasGFNI();
+			}
+
+			/** The environment variable forcing a kernel. */
+			constexpr char KERNEL_ENV[] = "ZFSERVER_TQCIPHER_KERNEL";
 		}
 
-		__forceinline __m256i _mm256_srli_epi8(__m256i __a, int __count)
+		const Kernel KERNELS[KERNEL_COUNT] = {
+			{ "avx512", &isAVX512Supported, true, &avx512::crypt, &avx512::cryptStream },
+			{ "avx2", &cpu::hasAVX2, false, &avx2::crypt, &avx2::cryptStream },
+			{ "sse2", &cpu::hasSSE2, false, &sse2::crypt, &sse2::cryptStream },
+			{ "scalar", &isAlwaysSupported, false, &scalar::crypt, &scalar::cryptStream },
+		};
+
+		namespace
 		{
-			static constexpr uint8_t MASKS[] = { 0xFF, 0x7F, 0x3F, 0x1F, 0x0F, 0x07, 0x03, 0x01 };
-			return _mm256_and_si256(_mm256_srli_epi16(__a, __count), _mm256_set1_epi8(MASKS[__count]));
+			const Kernel& selectKernel() noexcept
+			{
+				// allow forcing a (supported) kernel for A/B testing
+				const char* forced = std::getenv(KERNEL_ENV);
+				if (forced != nullptr)
+				{
+					for (const auto& kernel : KERNELS)
+					{
+						if (std::strcmp(kernel.name, forced) == 0 && kernel.isSupported())
+							return kernel;
+					}
+				}
+
+				for (const auto& kernel : KERNELS)
+				{
+					if (kernel.isSupported())
+						return kernel;
+				}
+
+				return KERNELS[KERNEL_COUNT - 1];
+			}
+
+			// selected once at startup
+			const Kernel& s_kernel = selectKernel();
 		}
-#elif defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-		__forceinline __m128i _mm_slli_epi8(__m128i __a, int __count)
+
+		const Kernel& kernel() noexcept
 		{
-			static constexpr uint8_t MASKS[] = { 0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80 };
-			return _mm_and_si128(_mm_slli_epi16(__a, __count), _mm_set1_epi8(MASKS[__count]));
+			return s_kernel;
 		}
 
-		__forceinline __m128i _mm_srli_epi8(__m128i __a, int __count)
+		namespace scalar
 		{
-			static constexpr uint8_t MASKS[] = { 0xFF, 0x7F, 0x3F, 0x1F, 0x0F, 0x07, 0x03, 0x01 };
-			return _mm_and_si128(_mm_srli_epi16(__a, __count), _mm_set1_epi8(MASKS[__count]));
+			void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+			{
+				for (size_t i = 0; i != len; ++i, ++counter)
+				{
+					uint8_t b = src[i] ^ 0xAB;
+					b = static_cast<uint8_t>(b << 4 | b >> 4);
+					b ^= key1[(counter) & 0xFF];
+					b ^= key2[(counter >> 8) & 0xFF];
+					dst[i] = b;
+				}
+			}
+
+			void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+			{
+				for (size_t i = 0; i != len; ++i, ++counter)
+				{
+					uint8_t b = src[i] ^ 0xAB;
+					b = static_cast<uint8_t>(b << 4 | b >> 4);
+					b ^= stream[counter];
+					dst[i] = b;
+				}
+			}
 		}
-#endif
 	}
 
-	TqCipher::TqCipher() noexcept
+	constexpr std::array<uint8_t, TqCipher::KEY_SIZE> TqCipher::generateBaseKey() noexcept
 	{
-		static constexpr uint32_t P = std::integral_constant<uint32_t, 0x13FA0F9D>::value;
-		static constexpr uint32_t G = std::integral_constant<uint32_t, 0x6D5C7962>::value;
+		// the layout expected by the kernels
+		static_assert(KEY_PADDING == tqcipher::KEY_PADDING);
+		static_assert(PARTIAL_KEY_SIZE == tqcipher::PARTIAL_KEY_SIZE);
+		static_assert(KEY_STREAM_SIZE == tqcipher::KEY_STREAM_SIZE + tqcipher::KEY_PADDING);
 
-		const uint8_t* p = reinterpret_cast<const uint8_t*>(&P);
-		const uint8_t* g = reinterpret_cast<const uint8_t*>(&G);
+		constexpr uint32_t P = 0x13FA0F9D;
+		constexpr uint32_t G = 0x6D5C7962;
 
-		uint8_t* key1 = m_key;
-		uint8_t* key2 = key1 + KEY_OFFSET;
+		// the bytes of P and G in memory order (little-endian)
+		constexpr uint8_t p[] = { P & 0xFF, (P >> 8) & 0xFF, (P >> 16) & 0xFF, (P >> 24) & 0xFF };
+		constexpr uint8_t g[] = { G & 0xFF, (G >> 8) & 0xFF, (G >> 16) & 0xFF, (G >> 24) & 0xFF };
+
+		std::array<uint8_t, KEY_SIZE> key = {};
 
 		uint8_t p0 = p[0];
 		uint8_t g0 = g[0];
 		for (size_t i = 0; i != PARTIAL_KEY_SIZE; ++i)
 		{
-			key1[i] = p0;
-			key2[i] = g0;
-			p0 = ((p[1] + static_cast<uint8_t>(p0 * p[2])) * p0 + p[3]);
-			g0 = ((g[1] - static_cast<uint8_t>(g0 * g[2])) * g0 + g[3]);
+			key[i] = p0;
+			key[KEY_OFFSET + i] = g0;
+			p0 = static_cast<uint8_t>((p[1] + static_cast<uint8_t>(p0 * p[2])) * p0 + p[3]);
+			g0 = static_cast<uint8_t>((g[1] - static_cast<uint8_t>(g0 * g[2])) * g0 + g[3]);
+		}
+
+		for (size_t i = 0; i != KEY_PADDING; ++i)
+		{
+			key[PARTIAL_KEY_SIZE + i] = key[i];
+			key[KEY_OFFSET + PARTIAL_KEY_SIZE + i] = key[KEY_OFFSET + i];
+		}
+
+		return key;
+	}
+
+	constexpr std::array<uint8_t, TqCipher::KEY_SIZE> TqCipher::s_key = TqCipher::generateBaseKey();
+
+	TqCipher::TqCipher(Mode mode)
+		: m_mode(mode)
+	{
+		if (m_mode == Mode::KeyStream)
+		{
+			// expand the pre-shared keystream now rather than on the first message
+			baseKeyStream();
+		}
+	}
+
+	const uint8_t* TqCipher::baseKeyStream()
+	{
+		// the pre-shared key is the same for every cipher, expand it only once
+		static const std::shared_ptr<const uint8_t[]> stream = expandKey(s_key.data(), s_key.data() + KEY_OFFSET);
+		return stream.get();
+	}
+
+	std::shared_ptr<const uint8_t[]> TqCipher::expandKey(const uint8_t* key1, const uint8_t* key2)
+	{
+		std::shared_ptr<uint8_t[]> stream(new uint8_t[KEY_STREAM_SIZE]);
+
+		uint8_t* data = stream.get();
+		for (size_t i = 0; i != PARTIAL_KEY_SIZE; ++i)
+		{
+			for (size_t j = 0; j != PARTIAL_KEY_SIZE; ++j)
+				data[i * PARTIAL_KEY_SIZE + j] = key1[j] ^ key2[i];
 		}
 
-#if defined(__SSE2__) || defined(__AVX2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-		std::memcpy(key1 + PARTIAL_KEY_SIZE, key1, KEY_PADDING);
-		std::memcpy(key2 + PARTIAL_KEY_SIZE, key2, KEY_PADDING);
-#endif
+		std::memcpy(data + 0x10000, data, KEY_PADDING);
+
+		return stream;
 	}
 
-	void TqCipher::generateAltKey(int32_t a, int32_t b) noexcept
+	void TqCipher::generateAltKey(int32_t a, int32_t b)
 	{
 		const uint32_t x = static_cast<uint32_t>(((a + b) ^ 0x4321) ^ a);
 		const uint32_t y = x * x;
 		const uint8_t* tmpKey1 = reinterpret_cast<const uint8_t*>(&x);
 		const uint8_t* tmpKey2 = reinterpret_cast<const uint8_t*>(&y);
 
-		const uint8_t* key1 = m_key;
+		std::shared_ptr<uint8_t[]> altKey(new uint8_t[KEY_SIZE]);
+
+		const uint8_t* key1 = s_key.data();
 		const uint8_t* key2 = key1 + KEY_OFFSET;
-		uint8_t* altKey1 = m_altKey;
+		uint8_t* altKey1 = altKey.get();
 		uint8_t* altKey2 = altKey1 + KEY_OFFSET;
 
 		for (size_t i = 0; i != PARTIAL_KEY_SIZE; ++i)
@@ -129,122 +214,187 @@ namespace zfserver::security
 			altKey2[i] = key2[i] ^ tmpKey2[(i % sizeof(y))];
 		}
 
-#if defined(__SSE2__) || defined(__AVX2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
 		std::memcpy(altKey1 + PARTIAL_KEY_SIZE, altKey1, KEY_PADDING);
 		std::memcpy(altKey2 + PARTIAL_KEY_SIZE, altKey2, KEY_PADDING);
-#endif
 
-		m_usingAltKey = true;
+		m_altKey = m_mode == Mode::KeyStream ? expandKey(altKey1, altKey2) : std::move(altKey);
 		m_encryptCounter = 0;
 	}
 
 	void TqCipher::encrypt(uint8_t* buf, size_t len) noexcept
 	{
-		assert(buf != nullptr);
-
-		const uint8_t* key1 = m_key;
-		const uint8_t* key2 = key1 + KEY_OFFSET;
-
-		size_t i = 0;
-
-#if defined(__SSE2__) || defined(__AVX2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-		alignas(vector_t) uint8_t tmp[sizeof(vector_t)];
-		vector_t* block = reinterpret_cast<vector_t*>(buf);
-		vector_t x, y, z, w;
-
-		z = _vector_set1_epi8(0xABU);
-		for (size_t i = 0, count = len / sizeof(vector_t); i != count; ++i)
-		{
-			x = _vector_loadu(reinterpret_cast<const vector_t*>(&key1[(m_encryptCounter) & 0xFF]));
+		encrypt(buf, buf, len);
+	}
 
-			const size_t n = 0x100 - m_encryptCounter % 0x100;
-			if (n >= sizeof(vector_t))
-			{
-				y = _vector_set1_epi8(key2[(m_encryptCounter >> 8) & 0xFF]);
-			}
-			else
-			{
-				std::memset(tmp, key2[(m_encryptCounter >> 8) & 0xFF], n);
-				std::memset(&tmp[n], key2[(uint8_t)(m_encryptCounter >> 8) + 1], sizeof(vector_t) - n);
-				y = _vector_load(reinterpret_cast<vector_t*>(tmp));
-			}
+	void TqCipher::encrypt(const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		encryptAt(m_encryptCounter, src, dst, len);
+		skipEncrypt(len);
+	}
 
-			w = _vector_loadu(&block[i]);
+	void TqCipher::decrypt(uint8_t* buf, size_t len) noexcept
+	{
+		decrypt(buf, buf, len);
+	}
 
-			w = _vector_xor(w, z);
-			w = _vector_or(_vector_slli_epi8(w, 4), _vector_srli_epi8(w, 4));
-			w = _vector_xor(_vector_xor(w, x), y);
+	void TqCipher::decrypt(const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		decryptAt(m_decryptCounter, src, dst, len);
+		skipDecrypt(len);
+	}
 
-			_vector_storeu(&block[i], w);
+	void TqCipher::encryptAt(uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) const noexcept
+	{
+		assert(src != nullptr);
+		assert(dst != nullptr);
 
-			m_encryptCounter += sizeof(vector_t);
+		const auto& kernel = tqcipher::kernel();
+		if (m_mode == Mode::KeyStream)
+		{
+			kernel.cryptStream(baseKeyStream(), counter, src, dst, len);
+		}
+		else
+		{
+			const uint8_t* key1 = s_key.data();
+			const uint8_t* key2 = key1 + KEY_OFFSET;
+			kernel.crypt(key1, key2, counter, src, dst, len);
 		}
+	}
 
-		i = len - (len % sizeof(vector_t));
-#endif
+	void TqCipher::decryptAt(uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) const noexcept
+	{
+		assert(src != nullptr);
+		assert(dst != nullptr);
 
-		for (; i != len; ++i)
+		const auto& kernel = tqcipher::kernel();
+		if (m_mode == Mode::KeyStream)
+		{
+			kernel.cryptStream(m_altKey != nullptr ? m_altKey.get() : baseKeyStream(), counter, src, dst, len);
+		}
+		else
 		{
-			buf[i] ^= 0xAB;
-			buf[i] = static_cast<uint8_t>(buf[i] << 4 | buf[i] >> 4);
-			buf[i] ^= key1[(m_encryptCounter) & 0xFF];
-			buf[i] ^= key2[(m_encryptCounter >> 8) & 0xFF];
-			++m_encryptCounter;
+			const uint8_t* key1 = m_altKey != nullptr ? m_altKey.get() : s_key.data();
+			const uint8_t* key2 = key1 + KEY_OFFSET;
+			kernel.crypt(key1, key2, counter, src, dst, len);
 		}
 	}
 
-	void TqCipher::decrypt(uint8_t* buf, size_t len) noexcept
+	void TqCipher::encryptBatch(const BatchItem* items, size_t count) noexcept
 	{
-		assert(buf != nullptr);
+		assert(items != nullptr || count == 0);
 
-		const uint8_t* key1 = m_usingAltKey ? m_altKey : m_key;
-		const uint8_t* key2 = key1 + KEY_OFFSET;
+		const auto& kernel = tqcipher::kernel();
 
-		size_t i = 0;
+		// without a scalar tail, a short buffer is already a single pass of the kernel
+		if (kernel.maskedTail)
+		{
+			for (size_t i = 0; i != count; ++i)
+			{
+				assert(items[i].cipher != nullptr);
+				items[i].cipher->encrypt(items[i].buf, items[i].len);
+			}
+			return;
+		}
 
-#if defined(__SSE2__) || defined(__AVX2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-		alignas(vector_t) uint8_t tmp[sizeof(vector_t)];
-		vector_t* block = reinterpret_cast<vector_t*>(buf);
-		vector_t x, y, z, w;
+		// the encryption key is the same for every cipher, so the keystream of a buffer
+		// is a slice of the expanded one: the buffers are staged back to back with their
+		// keystream, and processed together in full vectors
+		const uint8_t* base = baseKeyStream();
+		uint8_t data[BATCH_STAGING_SIZE];
+		uint8_t stream[BATCH_STAGING_SIZE + KEY_PADDING];
+		size_t staged = 0;
+		size_t first = 0; // the first staged item
 
-		z = _vector_set1_epi8(0xABU);
-		for (size_t i = 0, count = len / sizeof(vector_t); i != count; ++i)
+		const auto flush = [&](size_t last) noexcept
 		{
-			x = _vector_loadu(reinterpret_cast<const vector_t*>(&key1[(m_decryptCounter) & 0xFF]));
+			if (staged != 0)
+				kernel.cryptStream(stream, 0, data, data, staged);
 
-			const size_t n = 0x100 - m_decryptCounter % 0x100;
-			if (n >= sizeof(vector_t))
+			size_t offset = 0;
+			for (size_t i = first; i != last; ++i)
 			{
-				y = _vector_set1_epi8(key2[(m_decryptCounter >> 8) & 0xFF]);
+				if (items[i].len > BATCH_STAGING_SIZE)
+					continue; // encrypted directly
+
+				std::memcpy(items[i].buf, data + offset, items[i].len);
+				offset += items[i].len;
 			}
-			else
+
+			staged = 0;
+			first = last;
+		};
+
+		for (size_t i = 0; i != count; ++i)
+		{
+			const BatchItem& item = items[i];
+			assert(item.cipher != nullptr);
+			assert(item.buf != nullptr);
+
+			TqCipher& cipher = *item.cipher;
+			if (item.len > BATCH_STAGING_SIZE)
 			{
-				std::memset(tmp, key2[(m_decryptCounter >> 8) & 0xFF], n);
-				std::memset(&tmp[n], key2[(uint8_t)(m_decryptCounter >> 8) + 1], sizeof(vector_t) - n);
-				y = _vector_load(reinterpret_cast<vector_t*>(tmp));
+				cipher.encrypt(item.buf, item.len);
+				continue;
 			}
 
-			w = _vector_loadu(&block[i]);
-
-			w = _vector_xor(w, z);
-			w = _vector_or(_vector_slli_epi8(w, 4), _vector_srli_epi8(w, 4));
-			w = _vector_xor(_vector_xor(w, x), y);
+			if (staged + item.len > BATCH_STAGING_SIZE)
+				flush(i);
 
-			_vector_storeu(&block[i], w);
+			// the keystream wraps at the end of the period
+			const uint16_t counter = cipher.m_encryptCounter;
+			const size_t n = std::min<size_t>(item.len, 0x10000 - counter);
+			std::memcpy(data + staged, item.buf, item.len);
+			std::memcpy(stream + staged, base + counter, n);
+			std::memcpy(stream + staged + n, base, item.len - n);
+			staged += item.len;
 
-			m_decryptCounter += sizeof(vector_t);
+			// the same cipher may appear again later in the batch
+			cipher.skipEncrypt(item.len);
 		}
 
-		i = len - (len % sizeof(vector_t));
-#endif
+		flush(count);
+	}
 
-		for (; i != len; ++i)
-		{
-			buf[i] ^= 0xAB;
-			buf[i] = static_cast<uint8_t>(buf[i] << 4 | buf[i] >> 4);
-			buf[i] ^= key1[(m_decryptCounter) & 0xFF];
-			buf[i] ^= key2[(m_decryptCounter >> 8) & 0xFF];
-			++m_decryptCounter;
-		}
+	void TqCipher::peekDecrypt(const uint8_t* src, uint8_t* dst, size_t len) const noexcept
+	{
+		decryptAt(m_decryptCounter, src, dst, len);
+	}
+
+	TqCipher::State TqCipher::state() const noexcept
+	{
+		return { m_encryptCounter, m_decryptCounter };
+	}
+
+	void TqCipher::restore(const State& state) noexcept
+	{
+		m_encryptCounter = state.encryptCounter;
+		m_decryptCounter = state.decryptCounter;
+	}
+
+	uint16_t TqCipher::encryptCounter() const noexcept
+	{
+		return m_encryptCounter;
+	}
+
+	uint16_t TqCipher::decryptCounter() const noexcept
+	{
+		return m_decryptCounter;
+	}
+
+	void TqCipher::skipEncrypt(size_t len) noexcept
+	{
+		// the counter wraps around every 2^16 bytes
+		m_encryptCounter = static_cast<uint16_t>(m_encryptCounter + len);
+	}
+
+	void TqCipher::skipDecrypt(size_t len) noexcept
+	{
+		// the counter wraps around every 2^16 bytes
+		m_decryptCounter = static_cast<uint16_t>(m_decryptCounter + len);
+	}
+
+	const char* TqCipher::kernel() noexcept
+	{
+		return tqcipher::kernel().name;
 	}
 }
@@ -31,7 +31,9 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <emmintrin.h>
+
+#include <array>
+#include <memory>
 
 namespace zfserver::security
 {
@@ -47,15 +49,62 @@ namespace zfserver::security
 	 * (on the client side) or decrypting (on the server side). The cipher uses
 	 * two independent 16 bits counters to XOR a stream of data with the key.
 	 *
-	 * @remarks This implementation supports SSE2 and AVX2.
+	 * @remarks This implementation supports SSE2, AVX2 and AVX-512 (BW + GFNI). The
+	 *          fastest kernel supported by the host is selected at startup, unless the
+	 *          ZFSERVER_TQCIPHER_KERNEL environment variable forces one (scalar, sse2,
+	 *          avx2 or avx512).
 	 */
 	class TqCipher final
 	{
+	public:
+		/**
+		 * @brief A buffer to encrypt in-place with its cipher, as part of a batch.
+		 */
+		struct BatchItem
+		{
+			TqCipher* cipher;
+			uint8_t* buf;
+			size_t len;
+		};
+
+		/**
+		 * @brief A checkpoint of the position of the cipher in both streams.
+		 */
+		struct State
+		{
+			uint16_t encryptCounter;
+			uint16_t decryptCounter;
+		};
+
+		/**
+		 * @brief The representation of the key used to XOR the stream.
+		 */
+		enum class Mode : uint8_t
+		{
+			/** The two partial keys are combined for every byte (1 KiB per cipher). */
+			PartialKeys,
+			/** The partial keys are expanded once into a flat 64 KiB keystream. */
+			KeyStream,
+		};
+
 	public:
 		/**
 		 * @brief Creates a new TQ cipher using the Conquer Online pre-shared key.
+		 *
+		 * @remarks The pre-shared key is generated at compile-time and shared by every
+		 *          cipher, so creating (or resetting) a cipher is cheap.
 		 */
-		TqCipher() noexcept;
+		TqCipher() noexcept = default;
+
+		/**
+		 * @brief Creates a new TQ cipher using the Conquer Online pre-shared key.
+		 *
+		 * @param[in]  mode  The representation of the key to use.
+		 *
+		 * @remarks The keystream of the pre-shared key is expanded once and shared
+		 *          by every cipher. Only the alternative key is expanded per cipher.
+		 */
+		explicit TqCipher(Mode mode);
 
 		/* destructor */
 		~TqCipher() = default;
@@ -67,10 +116,11 @@ namespace zfserver::security
 		 * @param[in]  b  The second 32 bits value to use as a seed.
 		 *
 		 * @remarks A = Token, B = AccountUID in Conquer Online.
+		 * @remarks The alternative key is allocated by this call.
 		 *
 		 * @warning The decryption counter will be reset.
 		 */
-		void generateAltKey(int32_t a, int32_t b) noexcept;
+		void generateAltKey(int32_t a, int32_t b);
 
 		/**
 		 * @brief Encrypts the buffer.
@@ -82,6 +132,17 @@ namespace zfserver::security
 		 */
 		void encrypt(uint8_t* buf, size_t len) noexcept;
 
+		/**
+		 * @brief Encrypts the source buffer into the destination buffer.
+		 *
+		 * @param[in]   src  The buffer to encrypt.
+		 * @param[out]  dst  The buffer receiving the encrypted data.
+		 * @param[in]   len  The length (in bytes) of the buffers.
+		 *
+		 * @remarks The buffers may be the same, but must not partially overlap.
+		 */
+		void encrypt(const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+
 		/**
 		 * @brief Decrypts the buffer.
 		 *
@@ -92,16 +153,122 @@ namespace zfserver::security
 		 */
 		void decrypt(uint8_t* buf, size_t len) noexcept;
 
+		/**
+		 * @brief Decrypts the source buffer into the destination buffer.
+		 *
+		 * @param[in]   src  The buffer to decrypt.
+		 * @param[out]  dst  The buffer receiving the decrypted data.
+		 * @param[in]   len  The length (in bytes) of the buffers.
+		 *
+		 * @remarks The buffers may be the same, but must not partially overlap.
+		 */
+		void decrypt(const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+
+		/**
+		 * @brief Encrypts the source buffer into the destination buffer, starting at the counter.
+		 *
+		 * @param[in]   counter  The position of the first byte in the stream.
+		 * @param[in]   src      The buffer to encrypt.
+		 * @param[out]  dst      The buffer receiving the encrypted data.
+		 * @param[in]   len      The length (in bytes) of the buffers.
+		 *
+		 * @remarks The cipher is not modified, so disjoint parts of a stream can be
+		 *          encrypted concurrently. Use skipEncrypt to commit the stream.
+		 */
+		void encryptAt(uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) const noexcept;
+
+		/**
+		 * @brief Decrypts the source buffer into the destination buffer, starting at the counter.
+		 *
+		 * @param[in]   counter  The position of the first byte in the stream.
+		 * @param[in]   src      The buffer to decrypt.
+		 * @param[out]  dst      The buffer receiving the decrypted data.
+		 * @param[in]   len      The length (in bytes) of the buffers.
+		 *
+		 * @remarks The cipher is not modified, so disjoint parts of a stream can be
+		 *          decrypted concurrently. Use skipDecrypt to commit the stream.
+		 */
+		void decryptAt(uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) const noexcept;
+
+		/**
+		 * @brief Decrypts the source buffer into the destination buffer, without consuming it.
+		 *
+		 * @param[in]   src  The buffer to decrypt.
+		 * @param[out]  dst  The buffer receiving the decrypted data.
+		 * @param[in]   len  The length (in bytes) of the buffers.
+		 *
+		 * @remarks Allows looking ahead (e.g. at the header of a partial frame). Once the
+		 *          whole frame is available, only the remaining bytes need to be decrypted
+		 *          with decryptAt, before committing the frame with skipDecrypt.
+		 */
+		void peekDecrypt(const uint8_t* src, uint8_t* dst, size_t len) const noexcept;
+
+		/**
+		 * @brief Saves the position of the cipher.
+		 */
+		State state() const noexcept;
+
+		/**
+		 * @brief Restores a position previously saved.
+		 *
+		 * @param[in]  state  The position to restore.
+		 *
+		 * @remarks Only the counters are restored, not the keys.
+		 */
+		void restore(const State& state) noexcept;
+
+		/**
+		 * @brief Gets the position of the next byte to encrypt.
+		 */
+		uint16_t encryptCounter() const noexcept;
+
+		/**
+		 * @brief Gets the position of the next byte to decrypt.
+		 */
+		uint16_t decryptCounter() const noexcept;
+
+		/**
+		 * @brief Advances the encryption counter.
+		 *
+		 * @param[in]  len  The number of bytes encrypted outside of the cipher.
+		 */
+		void skipEncrypt(size_t len) noexcept;
+
+		/**
+		 * @brief Advances the decryption counter.
+		 *
+		 * @param[in]  len  The number of bytes decrypted outside of the cipher.
+		 */
+		void skipDecrypt(size_t len) noexcept;
+
+		/**
+		 * @brief Encrypts the buffers of many ciphers (e.g. sessions flushing on the same tick).
+		 *
+		 * @param[in]  items  The buffers to encrypt in-place, with their cipher.
+		 * @param[in]  count  The number of items.
+		 *
+		 * @remarks The encryption key is shared by all the ciphers, so the buffers are gathered
+		 *          back to back with their slice of the expanded keystream, and processed
+		 *          together in full vectors. Short (20-100 bytes) messages don't pay for a
+		 *          kernel call and a scalar tail each.
+		 * @remarks A cipher can appear more than once, its buffers are encrypted in order.
+		 * @remarks The buffers larger than the staging buffer are encrypted one by one, as are
+		 *          all the buffers when the kernel has no scalar tail (AVX-512).
+		 */
+		static void encryptBatch(const BatchItem* items, size_t count) noexcept;
+
+		/**
+		 * @brief Gets the name of the kernel selected at startup.
+		 */
+		static const char* kernel() noexcept;
+
 	private:
-#if defined(__AVX2__)
-		using vector_t = __m256i;
-		static constexpr size_t KEY_PADDING = sizeof(vector_t) - 1;
-#elif defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP == 2)
-		using vector_t = __m128i;
-		static constexpr size_t KEY_PADDING = sizeof(vector_t) - 1;
-#else
-		static constexpr size_t KEY_PADDING = 0;
-#endif
+		/**
+		 * @brief The size (in bytes) of the padding of the keys.
+		 *
+		 * @remarks The SIMD kernels load up to 64 bytes (AVX-512) past any counter.
+		 */
+		static constexpr size_t KEY_PADDING = 64 - 1;
 
 		/**
 		 * @brief The size (in bytes) of the partial keys.
@@ -113,7 +280,7 @@ namespace zfserver::security
 		/**
 		 * @brief The size (in bytes) of the key.
 		 *
-		 * @remarks When using SIMD, the partial keys have padding.
+		 * @remarks The partial keys have padding for the SIMD kernels.
 		 */
 		static constexpr size_t KEY_SIZE = (2 * PARTIAL_KEY_SIZE) + (2 * KEY_PADDING);
 
@@ -122,11 +289,51 @@ namespace zfserver::security
 		 */
 		static constexpr size_t KEY_OFFSET = PARTIAL_KEY_SIZE + KEY_PADDING;
 
+		/**
+		 * @brief The size (in bytes) of the expanded keystream.
+		 *
+		 * @remarks The keystream repeats every 2^16 bytes as the counters are 16 bits.
+		 *          The keystream has padding for the SIMD kernels.
+		 */
+		static constexpr size_t KEY_STREAM_SIZE = 0x10000 + KEY_PADDING;
+
+		/**
+		 * @brief The size (in bytes) of the staging buffer of the batches.
+		 */
+		static constexpr size_t BATCH_STAGING_SIZE = 4096;
+
+	private:
+		/**
+		 * @brief Generates the pre-shared key (both padded partial keys).
+		 */
+		static constexpr std::array<uint8_t, KEY_SIZE> generateBaseKey() noexcept;
+
+		/**
+		 * @brief Gets the expanded keystream of the pre-shared key.
+		 *
+		 * @remarks The keystream is expanded on first use, and shared by every cipher.
+		 */
+		static const uint8_t* baseKeyStream();
+
+		/**
+		 * @brief Expands the partial keys into a keystream.
+		 *
+		 * @param[in]  key1  The first partial key.
+		 * @param[in]  key2  The second partial key.
+		 */
+		static std::shared_ptr<const uint8_t[]> expandKey(const uint8_t* key1, const uint8_t* key2);
+
 	private:
-		uint8_t m_key[KEY_SIZE]; //!< The base key of the cipher.
+		static const std::array<uint8_t, KEY_SIZE> s_key; //!< The pre-shared key (shared by all ciphers).
 
-		uint8_t m_altKey[KEY_SIZE]; //!< The alternative key of the cipher.
-		bool m_usingAltKey = false; //!< Whether the alternative key should be used.
+		/**
+		 * @brief The alternative key of the cipher, if generated.
+		 *
+		 * @remarks The padded partial keys, or the expanded keystream depending on the mode.
+		 *          Immutable once generated, so copies of the cipher can share it.
+		 */
+		std::shared_ptr<const uint8_t[]> m_altKey;
+		Mode m_mode = Mode::PartialKeys; //!< The representation of the key.
 
 		uint16_t m_encryptCounter = 0; //!< The encryption counter.
 		uint16_t m_decryptCounter = 0; //!< The decryption counter.
@@ -0,0 +1,107 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "tqcipher_kernels.h"
+
+#include <immintrin.h>
+
+// Compiled with AVX2 enabled (/arch:AVX2)
+
+namespace zfserver::security::tqcipher::avx2
+{
+	namespace
+	{
+		inline __m256i swapNibbles(__m256i a) noexcept
+		{
+			return _mm256_or_si256(
+				_mm256_and_si256(_mm256_slli_epi16(a, 4), _mm256_set1_epi8(static_cast<char>(0xF0))),
+				_mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi8(0x0F)));
+		}
+
+		inline __m256i loadKey2(const uint8_t* key2, uint16_t counter) noexcept
+		{
+			const __m256i lo = _mm256_set1_epi8(static_cast<char>(key2[(counter >> 8) & 0xFF]));
+
+			// the block crosses a boundary of 256 bytes, the tail uses the next byte of key2
+			const size_t n = 0x100 - (counter & 0xFF);
+			if (n >= sizeof(__m256i))
+				return lo;
+
+			const __m256i hi = _mm256_set1_epi8(static_cast<char>(key2[((counter >> 8) + 1) & 0xFF]));
+			const __m256i mask = _mm256_cmpgt_epi8(
+				_mm256_set1_epi8(static_cast<char>(n)),
+				_mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+					16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31));
+			return _mm256_xor_si256(hi, _mm256_and_si256(_mm256_xor_si256(lo, hi), mask));
+		}
+	}
+
+	void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m256i z = _mm256_set1_epi8(static_cast<char>(0xAB));
+
+		size_t i = 0;
+		for (size_t count = len / sizeof(__m256i); i != count; ++i)
+		{
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&key1[counter & 0xFF]));
+			const __m256i y = loadKey2(key2, counter);
+
+			__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src) + i);
+			w = swapNibbles(_mm256_xor_si256(w, z));
+			w = _mm256_xor_si256(_mm256_xor_si256(w, x), y);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst) + i, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m256i));
+		}
+
+		i *= sizeof(__m256i);
+		scalar::crypt(key1, key2, counter, src + i, dst + i, len - i);
+	}
+
+	void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m256i z = _mm256_set1_epi8(static_cast<char>(0xAB));
+
+		size_t i = 0;
+		for (size_t count = len / sizeof(__m256i); i != count; ++i)
+		{
+			// the padding holds the start of the stream, so a block can wrap the counter
+			const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&stream[counter]));
+
+			__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src) + i);
+			w = swapNibbles(_mm256_xor_si256(w, z));
+			w = _mm256_xor_si256(w, x);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst) + i, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m256i));
+		}
+
+		i *= sizeof(__m256i);
+		scalar::cryptStream(stream, counter, src + i, dst + i, len - i);
+	}
+}
@@ -0,0 +1,105 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "tqcipher_kernels.h"
+
+#include <immintrin.h>
+
+// Compiled with AVX-512 enabled (/arch:AVX512), the kernel also requires GFNI
+
+namespace zfserver::security::tqcipher::avx512
+{
+	namespace
+	{
+		/**
+		 * The affine transformation rotating each byte by 4 bits.
+		 * With the constant 0xBA (0xAB rotated), it swaps the nibbles of (x ^ 0xAB).
+		 */
+		constexpr long long SWAP_NIBBLES = 0x1020408001020408LL;
+		constexpr int SWAPPED_XOR = 0xBA;
+
+		/** The truth table of a ^ b ^ c for the ternary logic. */
+		constexpr int XOR3 = 0x96;
+
+		inline __mmask64 firstBytes(size_t n) noexcept
+		{
+			return n >= 64 ? ~__mmask64(0) : (__mmask64(1) << n) - 1;
+		}
+
+		inline __m512i loadKey2(const uint8_t* key2, uint16_t counter) noexcept
+		{
+			const __m512i lo = _mm512_set1_epi8(static_cast<char>(key2[(counter >> 8) & 0xFF]));
+			const __m512i hi = _mm512_set1_epi8(static_cast<char>(key2[((counter >> 8) + 1) & 0xFF]));
+
+			// the block may cross a boundary of 256 bytes, the tail uses the next byte of key2
+			return _mm512_mask_blend_epi8(firstBytes(0x100 - (counter & 0xFF)), hi, lo);
+		}
+	}
+
+	void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m512i matrix = _mm512_set1_epi64(SWAP_NIBBLES);
+
+		// the tail is processed with masked loads and stores
+		for (size_t i = 0; i < len; i += sizeof(__m512i))
+		{
+			const __mmask64 mask = firstBytes(len - i);
+
+			const __m512i x = _mm512_loadu_si512(&key1[counter & 0xFF]);
+			const __m512i y = loadKey2(key2, counter);
+
+			__m512i w = _mm512_maskz_loadu_epi8(mask, src + i);
+			w = _mm512_gf2p8affine_epi64_epi8(w, matrix, SWAPPED_XOR);
+			w = _mm512_ternarylogic_epi32(w, x, y, XOR3);
+			_mm512_mask_storeu_epi8(dst + i, mask, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m512i));
+		}
+	}
+
+	void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m512i matrix = _mm512_set1_epi64(SWAP_NIBBLES);
+
+		// the tail is processed with masked loads and stores
+		for (size_t i = 0; i < len; i += sizeof(__m512i))
+		{
+			const __mmask64 mask = firstBytes(len - i);
+
+			// the padding holds the start of the stream, so a block can wrap the counter
+			const __m512i x = _mm512_loadu_si512(&stream[counter]);
+
+			__m512i w = _mm512_maskz_loadu_epi8(mask, src + i);
+			w = _mm512_gf2p8affine_epi64_epi8(w, matrix, SWAPPED_XOR);
+			w = _mm512_xor_si512(w, x);
+			_mm512_mask_storeu_epi8(dst + i, mask, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m512i));
+		}
+	}
+}
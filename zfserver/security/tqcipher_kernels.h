@@ -0,0 +1,113 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_SECURITY_TQ_CIPHER_KERNELS_H
+#define ZFSERVER_SECURITY_TQ_CIPHER_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Internal header of the TQ cipher. Each SIMD kernel lives in its own translation
+// unit compiled for its instruction set. The kernel is selected at runtime.
+//
+// All kernels XOR len bytes of src, starting at the counter, and store them in dst.
+// The source and destination may be the same buffer. The partial keys and the
+// keystream must be followed by (at least) 63 bytes of padding repeating their start.
+
+namespace zfserver::security::tqcipher
+{
+	/** The size (in bytes) of the padding following the keys, the kernels load up to 64 bytes past any counter. */
+	constexpr size_t KEY_PADDING = 64 - 1;
+	/** The size (in bytes) of the partial keys, without their padding. */
+	constexpr size_t PARTIAL_KEY_SIZE = 256;
+	/** The size (in bytes) of the expanded keystream, without its padding. */
+	constexpr size_t KEY_STREAM_SIZE = 0x10000;
+
+	/** Processes the buffer with the two partial keys. */
+	using CryptFn = void (*)(const uint8_t* key1, const uint8_t* key2, uint16_t counter,
+		const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+
+	/** Processes the buffer with the expanded keystream. */
+	using CryptStreamFn = void (*)(const uint8_t* stream, uint16_t counter,
+		const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+
+	/**
+	 * A set of kernels targeting an instruction set.
+	 */
+	struct Kernel
+	{
+		/** The name of the instruction set (can be forced through the environment) */
+		const char* name;
+		/** Whether the host supports the instruction set */
+		bool (*isSupported)() noexcept;
+		/** Whether the partial vector at the end is processed with masks (not in scalar) */
+		bool maskedTail;
+
+		CryptFn crypt;
+		CryptStreamFn cryptStream;
+	};
+
+	/** The number of kernels. */
+	constexpr size_t KERNEL_COUNT = 4;
+
+	/**
+	 * All the kernels, from the fastest to the slowest (including the ones the host doesn't support).
+	 */
+	extern const Kernel KERNELS[KERNEL_COUNT];
+
+	/**
+	 * The kernel selected at startup.
+	 */
+	const Kernel& kernel() noexcept;
+
+	namespace scalar
+	{
+		void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+		void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+	}
+
+	namespace sse2
+	{
+		void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+		void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+	}
+
+	namespace avx2
+	{
+		void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+		void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+	}
+
+	namespace avx512
+	{
+		void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+		void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept;
+	}
+}
+
+#endif // ZFSERVER_SECURITY_TQ_CIPHER_KERNELS_H
@@ -0,0 +1,106 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "tqcipher_kernels.h"
+
+#include <emmintrin.h>
+
+// Compiled with SSE2 enabled (default for x86 builds)
+
+namespace zfserver::security::tqcipher::sse2
+{
+	namespace
+	{
+		inline __m128i swapNibbles(__m128i a) noexcept
+		{
+			return _mm_or_si128(
+				_mm_and_si128(_mm_slli_epi16(a, 4), _mm_set1_epi8(static_cast<char>(0xF0))),
+				_mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi8(0x0F)));
+		}
+
+		inline __m128i loadKey2(const uint8_t* key2, uint16_t counter) noexcept
+		{
+			const __m128i lo = _mm_set1_epi8(static_cast<char>(key2[(counter >> 8) & 0xFF]));
+
+			// the block crosses a boundary of 256 bytes, the tail uses the next byte of key2
+			const size_t n = 0x100 - (counter & 0xFF);
+			if (n >= sizeof(__m128i))
+				return lo;
+
+			const __m128i hi = _mm_set1_epi8(static_cast<char>(key2[((counter >> 8) + 1) & 0xFF]));
+			const __m128i mask = _mm_cmplt_epi8(
+				_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+				_mm_set1_epi8(static_cast<char>(n)));
+			return _mm_xor_si128(hi, _mm_and_si128(_mm_xor_si128(lo, hi), mask));
+		}
+	}
+
+	void crypt(const uint8_t* key1, const uint8_t* key2, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m128i z = _mm_set1_epi8(static_cast<char>(0xAB));
+
+		size_t i = 0;
+		for (size_t count = len / sizeof(__m128i); i != count; ++i)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&key1[counter & 0xFF]));
+			const __m128i y = loadKey2(key2, counter);
+
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + i);
+			w = swapNibbles(_mm_xor_si128(w, z));
+			w = _mm_xor_si128(_mm_xor_si128(w, x), y);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + i, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m128i));
+		}
+
+		i *= sizeof(__m128i);
+		scalar::crypt(key1, key2, counter, src + i, dst + i, len - i);
+	}
+
+	void cryptStream(const uint8_t* stream, uint16_t counter, const uint8_t* src, uint8_t* dst, size_t len) noexcept
+	{
+		const __m128i z = _mm_set1_epi8(static_cast<char>(0xAB));
+
+		size_t i = 0;
+		for (size_t count = len / sizeof(__m128i); i != count; ++i)
+		{
+			// the padding holds the start of the stream, so a block can wrap the counter
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stream[counter]));
+
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + i);
+			w = swapNibbles(_mm_xor_si128(w, z));
+			w = _mm_xor_si128(w, x);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst) + i, w);
+
+			counter = static_cast<uint16_t>(counter + sizeof(__m128i));
+		}
+
+		i *= sizeof(__m128i);
+		scalar::cryptStream(stream, counter, src + i, dst + i, len - i);
+	}
+}
@@ -0,0 +1,121 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "serverthread.h"
+#include "client.h"
+
+#include "log.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace zfserver
+{
+	namespace
+	{
+		bool isSet(const char* env) noexcept
+		{
+			const char* value = std::getenv(env);
+			return value != nullptr && std::strcmp(value, "1") == 0;
+		}
+	}
+
+	bool ServerThread::isEnabled() noexcept
+	{
+		return isSet(ENABLE_ENV);
+	}
+
+	bool ServerThread::isPreEncryptEnabled() noexcept
+	{
+		return isSet(PRE_ENCRYPT_ENV);
+	}
+
+	ServerThread::ServerThread(Client& client)
+		: m_client(client)
+	{
+		m_thread = std::thread(&ServerThread::run, this);
+	}
+
+	ServerThread::~ServerThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wakeUp.notify_one();
+
+		m_thread.join();
+	}
+
+	void ServerThread::post(Connection& connection, const uint8_t* frames, size_t len)
+	{
+		assert(frames != nullptr);
+
+		Batch batch = { &connection, network::MsgPool::instance().allocate(len), len };
+		std::memcpy(batch.frames.get(), frames, len);
+
+		// the game only waits when the thread is far behind
+		while (!m_queue.tryPush(std::move(batch)))
+			std::this_thread::yield();
+
+		// pairs with the fence of the thread, either it sees the batch or we see it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_wakeUp.notify_one();
+		}
+	}
+
+	void ServerThread::run()
+	{
+		LOG(VRB, "Server thread started...");
+
+		Batch batch;
+		for (;;)
+		{
+			while (m_queue.tryPop(batch))
+			{
+				m_client.dispatch(*batch.connection, batch.frames.get(), batch.length);
+				batch = {};
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_stopping)
+				break;
+
+			m_sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_wakeUp.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+			m_sleeping.store(false, std::memory_order_relaxed);
+		}
+
+		LOG(VRB, "Server thread stopped...");
+	}
+}
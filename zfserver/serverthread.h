@@ -0,0 +1,106 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_SERVER_THREAD_H
+#define ZFSERVER_SERVER_THREAD_H
+
+#include "spscqueue.h"
+
+#include "network/msgpool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace zfserver
+{
+	class Client;
+	class Connection;
+
+	// Dedicated thread running the message handlers, out of the game's frame
+	// loop. The hooked send only decrypts and posts the complete frames, and
+	// the responses are queued for the next recv.
+	class ServerThread final
+	{
+	public:
+		// the environment variable enabling the server thread (when "1")
+		static constexpr char ENABLE_ENV[] = "ZFSERVER_SERVER_THREAD";
+		// the environment variable enabling the encryption of the responses on the thread (when "1")
+		static constexpr char PRE_ENCRYPT_ENV[] = "ZFSERVER_PRE_ENCRYPT";
+		// the maximum number of batches waiting for the thread
+		static constexpr size_t QUEUE_CAPACITY = 1024;
+
+	public:
+		// whether the server thread is enabled
+		static bool isEnabled() noexcept;
+
+		// whether the server thread also encrypts the responses
+		static bool isPreEncryptEnabled() noexcept;
+
+	public:
+		explicit ServerThread(Client& client);
+		~ServerThread();
+
+		ServerThread(ServerThread&& other) = delete;
+		ServerThread(const ServerThread& other) = delete;
+		ServerThread& operator=(ServerThread&& other) = delete;
+		ServerThread& operator=(const ServerThread& other) = delete;
+
+		// copies the frames, to be dispatched on the thread (from the game thread only)
+		void post(Connection& connection, const uint8_t* frames, size_t len);
+
+	private:
+		// complete frames sent on a connection
+		struct Batch
+		{
+			Connection* connection = nullptr;
+			network::MsgPool::Buffer frames = {};
+			size_t length = 0;
+		};
+
+		// the loop of the thread
+		void run();
+
+	private:
+		Client& m_client;
+		SpscQueue<Batch, QUEUE_CAPACITY> m_queue = {};
+
+		std::mutex m_mutex = {}; // only to sleep when the queue is empty
+		std::condition_variable m_wakeUp = {};
+		std::atomic<bool> m_sleeping = { false };
+		std::atomic<bool> m_stopping = { false };
+
+		std::thread m_thread = {}; // started last, once the members are ready
+	};
+}
+
+#endif // ZFSERVER_SERVER_THREAD_H
@@ -0,0 +1,92 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_SPSC_QUEUE_H
+#define ZFSERVER_SPSC_QUEUE_H
+
+#include <cstddef>
+
+#include <atomic>
+#include <utility>
+
+namespace zfserver
+{
+	// Bounded lock-free queue, for a single producer thread and a single
+	// consumer thread. The capacity must be a power of two.
+	template<typename T, size_t Capacity>
+	class SpscQueue final
+	{
+		static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "the capacity must be a power of two");
+
+	public:
+		SpscQueue() = default;
+		~SpscQueue() = default;
+
+		SpscQueue(SpscQueue&& other) = delete;
+		SpscQueue(const SpscQueue& other) = delete;
+		SpscQueue& operator=(SpscQueue&& other) = delete;
+		SpscQueue& operator=(const SpscQueue& other) = delete;
+
+		// pushes the item at the back (from the producer), fails if full
+		bool tryPush(T&& item)
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+				return false;
+
+			m_items[tail & (Capacity - 1)] = std::move(item);
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// pops the item at the front (from the consumer), fails if empty
+		bool tryPop(T& item)
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return false;
+
+			item = std::move(m_items[head & (Capacity - 1)]);
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool empty() const noexcept
+		{
+			return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		// on their own cache lines, so the producer and the consumer don't contend
+		alignas(64) std::atomic<size_t> m_head = { 0 }; // the next item to pop
+		alignas(64) std::atomic<size_t> m_tail = { 0 }; // the next slot to push
+		alignas(64) T m_items[Capacity] = {};
+	};
+}
+
+#endif // ZFSERVER_SPSC_QUEUE_H
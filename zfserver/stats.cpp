@@ -0,0 +1,164 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "stats.h"
+
+#include "log.h"
+#include "network/networkdef.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <new>
+
+#include <windows.h>
+
+namespace zfserver::stats
+{
+	namespace
+	{
+		std::atomic<File*> s_file = { nullptr }; //!< the mapped file, nullptr if disabled
+
+		thread_local Shard* t_shard = nullptr; //!< the shard of the thread, once claimed
+		thread_local bool t_claimed = false; //!< whether the thread tried to claim a shard
+
+		bool isEnabled() noexcept
+		{
+			const char* value = std::getenv(ENABLE_ENV);
+			return value != nullptr && std::strcmp(value, "1") == 0;
+		}
+	}
+
+	void Histogram::record(uint64_t nanoseconds) noexcept
+	{
+		add(count, 1);
+		add(sum, nanoseconds);
+		if (nanoseconds > max.load(std::memory_order_relaxed))
+			max.store(nanoseconds, std::memory_order_relaxed);
+		add(buckets[bucketOf(nanoseconds)], 1);
+	}
+
+	void initialize() noexcept
+	{
+		if (!isEnabled() || s_file.load(std::memory_order_relaxed) != nullptr)
+			return;
+
+		const DWORD processId = GetCurrentProcessId();
+
+		char path[64];
+		std::snprintf(path, sizeof(path), "./zfserver_%lu.stats", static_cast<unsigned long>(processId));
+
+		// shared for reading (and deleting) by the tools while mapped
+		HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			LOG(ERROR, "Failed to create the stats file %s (%lu)", path, GetLastError());
+			return;
+		}
+
+		// the file is extended with zeroes, so all the values start at zero
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(sizeof(File)), nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+		{
+			LOG(ERROR, "Failed to map the stats file %s (%lu)", path, GetLastError());
+			return;
+		}
+
+		// the view keeps the mapping alive until the process exits
+		void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(File));
+		CloseHandle(mapping);
+		if (view == nullptr)
+		{
+			LOG(ERROR, "Failed to map the stats file %s (%lu)", path, GetLastError());
+			return;
+		}
+
+		File* stats = new (view) File;
+		Header& header = stats->header;
+		header.version = FILE_VERSION;
+		header.shardCount = static_cast<uint16_t>(SHARD_COUNT);
+		header.probeCount = static_cast<uint32_t>(PROBE_COUNT);
+		header.typeCount = static_cast<uint32_t>(TYPE_COUNT);
+		header.handlerCount = static_cast<uint32_t>(HANDLER_COUNT);
+		header.bucketCount = static_cast<uint32_t>(BUCKET_COUNT);
+		header.subBucketBits = SUB_BUCKET_BITS;
+		header.processId = static_cast<uint32_t>(processId);
+		header.startTime = static_cast<int64_t>(std::time(nullptr));
+		header.usedShards.store(0, std::memory_order_relaxed);
+
+		// the magic last, the readers wait for it
+		std::atomic_thread_fence(std::memory_order_release);
+		header.magic = FILE_MAGIC;
+
+		s_file.store(stats, std::memory_order_release);
+		LOG(INFO, "Writing the stats in %s", path);
+	}
+
+	Shard* shard() noexcept
+	{
+		if (t_shard != nullptr)
+			return t_shard;
+
+		File* file = s_file.load(std::memory_order_acquire);
+		if (file == nullptr || t_claimed)
+			return nullptr;
+
+		// the first call of the thread claims the next shard
+		t_claimed = true;
+		const uint32_t index = file->header.usedShards.fetch_add(1, std::memory_order_relaxed);
+		if (index >= SHARD_COUNT)
+		{
+			LOG(WARN, "No stats shard left for thread %lu", GetCurrentThreadId());
+			return nullptr;
+		}
+
+		t_shard = &file->shards[index];
+		t_shard->threadId.store(GetCurrentThreadId(), std::memory_order_relaxed);
+		return t_shard;
+	}
+
+	void count(Direction direction, uint16_t type, size_t bytes) noexcept
+	{
+		Shard* current = shard();
+		if (current == nullptr)
+			return;
+
+		// the types out of range share the last counter
+		size_t index = type >= network::MSG_GENERAL ? static_cast<size_t>(type - network::MSG_GENERAL) : TYPE_COUNT - 1;
+		index = std::min(index, TYPE_COUNT - 1);
+
+		Counter& counter = current->types[static_cast<size_t>(direction)][index];
+		add(counter.count, 1);
+		add(counter.bytes, bytes);
+	}
+}
@@ -0,0 +1,234 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_STATS_H
+#define ZFSERVER_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+
+// Lock-free counters and latency histograms of the in-process server. Each
+// thread records in its own shard of a memory-mapped file, which the zfstats
+// tool reads live from another process. Enabled with ZFSERVER_STATS=1, otherwise
+// the calls only test a null pointer.
+
+namespace zfserver::stats
+{
+	// the environment variable enabling the stats (when "1")
+	constexpr char ENABLE_ENV[] = "ZFSERVER_STATS";
+
+	// the timed calls
+	enum class Probe : uint8_t
+	{
+		ProcessOutgoing = 0, // the hooked send
+		RecvFrom = 1, // the hooked recv
+		Encrypt = 2,
+		Decrypt = 3,
+	};
+
+	enum class Direction : uint8_t
+	{
+		Received = 0, // sent by the game
+		Sent = 1, // sent by the server
+	};
+
+	constexpr size_t PROBE_COUNT = 4;
+	constexpr size_t DIRECTION_COUNT = 2;
+	// the message types counted, from MSG_GENERAL (the last one counts all the others)
+	constexpr size_t TYPE_COUNT = 1048;
+	// the message handlers timed, by their index in the handler table
+	constexpr size_t HANDLER_COUNT = 16;
+	// the threads recording, the others are ignored (and counted)
+	constexpr size_t SHARD_COUNT = 16;
+
+	// HDR-style histogram of nanoseconds: 8 linear sub-buckets per power of two (a
+	// relative error below 12.5%), up to 2^40 ns (the larger values are clamped)
+	constexpr uint32_t SUB_BUCKET_BITS = 3;
+	constexpr uint32_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+	constexpr uint32_t MAX_VALUE_BITS = 40;
+	constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+	// the bucket of a value
+	constexpr size_t bucketOf(uint64_t value) noexcept
+	{
+		if (value < SUB_BUCKET_COUNT)
+			return static_cast<size_t>(value);
+
+		// the most significant bit, in a few steps
+		uint32_t msb = 0;
+		for (uint32_t step = 32; step != 0; step >>= 1)
+		{
+			if ((value >> (msb + step)) != 0)
+				msb += step;
+		}
+
+		if (msb >= MAX_VALUE_BITS)
+			return BUCKET_COUNT - 1;
+
+		const uint32_t shift = msb - SUB_BUCKET_BITS;
+		return static_cast<size_t>((shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1)));
+	}
+
+	// the lowest value of a bucket
+	constexpr uint64_t lowestValueOf(size_t bucket) noexcept
+	{
+		if (bucket < SUB_BUCKET_COUNT)
+			return bucket;
+
+		const uint32_t shift = static_cast<uint32_t>(bucket / SUB_BUCKET_COUNT) - 1;
+		return static_cast<uint64_t>(SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+	}
+
+	static_assert(bucketOf(7) == 7 && bucketOf(8) == 8 && bucketOf(15) == 15 && bucketOf(16) == 16 && bucketOf(17) == 16);
+	static_assert(lowestValueOf(bucketOf(1000)) <= 1000 && lowestValueOf(bucketOf(1000) + 1) > 1000);
+	static_assert(bucketOf(~0ull) == BUCKET_COUNT - 1);
+
+	// a value written by a single thread, and read by any process
+	using Value = std::atomic<uint64_t>;
+	static_assert(sizeof(Value) == sizeof(uint64_t) && Value::is_always_lock_free, "the values are shared with the readers");
+
+	// single writer, so a plain load and store instead of a locked add
+	inline void add(Value& value, uint64_t n) noexcept
+	{
+		value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	struct Histogram
+	{
+		Value count;
+		Value sum;
+		Value max;
+		Value buckets[BUCKET_COUNT];
+
+		void record(uint64_t nanoseconds) noexcept;
+	};
+
+	struct Counter
+	{
+		Value count;
+		Value bytes;
+	};
+
+	struct Handler
+	{
+		Value type; // the message type of the handler, once recorded
+		Histogram latency;
+	};
+
+	struct alignas(64) Shard
+	{
+		Value threadId;
+		Counter types[DIRECTION_COUNT][TYPE_COUNT];
+		Histogram probes[PROBE_COUNT];
+		Handler handlers[HANDLER_COUNT];
+	};
+
+	// the file: a Header, then SHARD_COUNT shards
+	constexpr uint32_t FILE_MAGIC = 0x5453465A; // "ZFST"
+	constexpr uint16_t FILE_VERSION = 1;
+
+	struct alignas(64) Header
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t shardCount;
+		uint32_t probeCount;
+		uint32_t typeCount;
+		uint32_t handlerCount;
+		uint32_t bucketCount;
+		uint32_t subBucketBits;
+		uint32_t processId;
+		int64_t startTime; // in seconds since the epoch
+		std::atomic<uint32_t> usedShards; // claimed by the threads, in order (may exceed shardCount)
+	};
+
+	struct File
+	{
+		Header header;
+		Shard shards[SHARD_COUNT];
+	};
+
+	// maps the stats file of the process, if enabled by the environment
+	void initialize() noexcept;
+
+	// the shard of the calling thread, nullptr if disabled (or all the shards are used)
+	Shard* shard() noexcept;
+
+	// the latency histogram of a probe, nullptr if disabled
+	inline Histogram* latency(Probe probe) noexcept
+	{
+		Shard* current = shard();
+		return current != nullptr ? &current->probes[static_cast<size_t>(probe)] : nullptr;
+	}
+
+	// the latency histogram of a message handler, nullptr if disabled
+	inline Histogram* latency(size_t handler, uint16_t type) noexcept
+	{
+		Shard* current = shard();
+		if (current == nullptr || handler >= HANDLER_COUNT)
+			return nullptr;
+
+		current->handlers[handler].type.store(type, std::memory_order_relaxed);
+		return &current->handlers[handler].latency;
+	}
+
+	// counts a message of the type
+	void count(Direction direction, uint16_t type, size_t bytes) noexcept;
+
+	// records the lifetime of the scope, only reading the clock if the histogram exists
+	class ScopedTimer final
+	{
+	public:
+		explicit ScopedTimer(Histogram* histogram) noexcept
+			: m_histogram(histogram)
+		{
+			if (m_histogram != nullptr)
+				m_start = std::chrono::steady_clock::now();
+		}
+
+		~ScopedTimer()
+		{
+			if (m_histogram != nullptr)
+				m_histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+		}
+
+		ScopedTimer(ScopedTimer&& other) = delete;
+		ScopedTimer(const ScopedTimer& other) = delete;
+		ScopedTimer& operator=(ScopedTimer&& other) = delete;
+		ScopedTimer& operator=(const ScopedTimer& other) = delete;
+
+	private:
+		Histogram* m_histogram;
+		std::chrono::steady_clock::time_point m_start = {};
+	};
+}
+
+#endif // ZFSERVER_STATS_H
@@ -0,0 +1,224 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "trace.h"
+
+#include "log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <windows.h>
+
+namespace zfserver::trace
+{
+	// a finished span, written by its thread only and read by the export
+	struct Span
+	{
+		std::atomic<const char*> name;
+		std::atomic<const char*> argName;
+		std::atomic<uint32_t> arg;
+		std::atomic<int64_t> start; // in nanoseconds, on the steady clock
+		std::atomic<int64_t> duration; // in nanoseconds
+	};
+
+	// the last spans of a thread, overwritten in order
+	struct Ring
+	{
+		DWORD threadId = 0;
+		std::atomic<uint64_t> next = { 0 }; // the number of spans recorded, published after the span
+		Span spans[SPAN_COUNT];
+	};
+
+	namespace
+	{
+		std::atomic<bool> s_enabled = { false };
+
+		std::mutex s_ringsMutex; // protects the list, not the rings
+		std::vector<std::unique_ptr<Ring>> s_rings; // kept until the process exits, for the export
+
+		thread_local Ring* t_ring = nullptr;
+
+		// a copy of a span, for the export
+		struct Event
+		{
+			const char* name;
+			const char* argName;
+			uint32_t arg;
+			int64_t start;
+			int64_t duration;
+		};
+
+		// copies the spans of a ring, without those overwritten during the copy
+		std::vector<Event> snapshot(const Ring& ring)
+		{
+			const uint64_t end = ring.next.load(std::memory_order_acquire);
+			const uint64_t begin = end > SPAN_COUNT ? end - SPAN_COUNT : 0;
+
+			std::vector<Event> events;
+			events.reserve(static_cast<size_t>(end - begin));
+			for (uint64_t i = begin; i != end; ++i)
+			{
+				const Span& span = ring.spans[i % SPAN_COUNT];
+				events.push_back({
+					span.name.load(std::memory_order_relaxed),
+					span.argName.load(std::memory_order_relaxed),
+					span.arg.load(std::memory_order_relaxed),
+					span.start.load(std::memory_order_relaxed),
+					span.duration.load(std::memory_order_relaxed) });
+			}
+
+			// the thread kept recording, the oldest slots may have been reused (the one
+			// of the span being written included)
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t last = ring.next.load(std::memory_order_relaxed) + 1;
+			const uint64_t overwritten = last - begin > SPAN_COUNT ? last - begin - SPAN_COUNT : 0;
+			events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min<uint64_t>(overwritten, events.size())));
+
+			return events;
+		}
+	}
+
+	void initialize() noexcept
+	{
+		const char* value = std::getenv(ENABLE_ENV);
+		if (value != nullptr && std::strcmp(value, "1") == 0)
+		{
+			s_enabled = true;
+			LOG(INFO, "Tracing the message processing, say %s to export the spans", DUMP_COMMAND);
+		}
+	}
+
+	Ring* ring() noexcept
+	{
+		if (t_ring != nullptr || !s_enabled.load(std::memory_order_relaxed))
+			return t_ring;
+
+		// the first span of the thread allocates its ring
+		try
+		{
+			auto ring = std::make_unique<Ring>();
+			ring->threadId = GetCurrentThreadId();
+
+			std::lock_guard<std::mutex> lock(s_ringsMutex);
+			s_rings.emplace_back(std::move(ring));
+			t_ring = s_rings.back().get();
+		}
+		catch (...)
+		{
+			s_enabled = false; // out of memory, nothing is traced
+		}
+
+		return t_ring;
+	}
+
+	void record(Ring& ring, const char* name, const char* argName, uint32_t arg, int64_t start, int64_t duration) noexcept
+	{
+		const uint64_t index = ring.next.load(std::memory_order_relaxed);
+
+		Span& span = ring.spans[index % SPAN_COUNT];
+		span.name.store(name, std::memory_order_relaxed);
+		span.argName.store(argName, std::memory_order_relaxed);
+		span.arg.store(arg, std::memory_order_relaxed);
+		span.start.store(start, std::memory_order_relaxed);
+		span.duration.store(duration, std::memory_order_relaxed);
+
+		ring.next.store(index + 1, std::memory_order_release);
+	}
+
+	bool dump() noexcept
+	{
+		if (!s_enabled.load(std::memory_order_relaxed))
+			return false;
+
+		char path[64];
+		std::snprintf(path, sizeof(path), "./trace_%lld.json", static_cast<long long>(std::time(nullptr)));
+
+		std::vector<Ring*> rings;
+		try
+		{
+			std::lock_guard<std::mutex> lock(s_ringsMutex);
+			for (const auto& ring : s_rings)
+				rings.push_back(ring.get());
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		FILE* file = std::fopen(path, "w");
+		if (file == nullptr)
+		{
+			LOG(ERROR, "Failed to open %s", path);
+			return false;
+		}
+
+		// the complete events ("X") of the Chrome trace event format, with the times in microseconds
+		const unsigned long processId = GetCurrentProcessId();
+		std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+		bool first = true;
+		size_t count = 0;
+		for (const Ring* ring : rings)
+		{
+			std::vector<Event> events;
+			try
+			{
+				events = snapshot(*ring);
+			}
+			catch (...)
+			{
+				continue; // out of memory, the thread is skipped
+			}
+
+			for (const Event& event : events)
+			{
+				std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"zfserver\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%u}}",
+					first ? "" : ",\n", event.name, processId, static_cast<unsigned long>(ring->threadId),
+					event.start / 1000.0, event.duration / 1000.0, event.argName, event.arg);
+				first = false;
+			}
+			count += events.size();
+		}
+
+		std::fprintf(file, "\n]}\n");
+		const bool written = std::ferror(file) == 0;
+		std::fclose(file);
+
+		if (written)
+			LOG(INFO, "%zu spans of %zu threads exported in %s", count, rings.size(), path);
+		return written;
+	}
+}
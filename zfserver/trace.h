@@ -0,0 +1,105 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef ZFSERVER_TRACE_H
+#define ZFSERVER_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+
+// Spans of the message processing, for the individual slow frames the stats
+// average out. Each thread records its last spans in its own lock-free ring,
+// and the rings are exported as Chrome trace events (chrome://tracing or
+// Perfetto) on demand. Enabled with ZFSERVER_TRACE=1, otherwise a span only
+// tests a null pointer.
+
+namespace zfserver::trace
+{
+	// the environment variable enabling the tracing (when "1")
+	constexpr char ENABLE_ENV[] = "ZFSERVER_TRACE";
+	// said in the game's chat to export the spans
+	constexpr char DUMP_COMMAND[] = "/tracedump";
+	// the number of spans kept per thread, the oldest are overwritten
+	constexpr size_t SPAN_COUNT = 16384;
+
+	struct Ring;
+
+	// reads the environment, before any span
+	void initialize() noexcept;
+
+	// the ring of the calling thread, nullptr if disabled
+	Ring* ring() noexcept;
+
+	// records a finished span in the ring (the names are literals, only their pointer is kept)
+	void record(Ring& ring, const char* name, const char* argName, uint32_t arg, int64_t start, int64_t duration) noexcept;
+
+	// writes the spans of all the threads as Chrome trace events, in ./trace_<time>.json
+	bool dump() noexcept;
+
+	// records the lifetime of the scope, only reading the clock if enabled
+	class ScopedSpan final
+	{
+	public:
+		ScopedSpan(const char* name, const char* argName, uint32_t arg) noexcept
+			: m_ring(ring()), m_name(name), m_argName(argName), m_arg(arg)
+		{
+			if (m_ring != nullptr)
+				m_start = now();
+		}
+
+		~ScopedSpan()
+		{
+			if (m_ring != nullptr)
+				record(*m_ring, m_name, m_argName, m_arg, m_start, now() - m_start);
+		}
+
+		ScopedSpan(ScopedSpan&& other) = delete;
+		ScopedSpan(const ScopedSpan& other) = delete;
+		ScopedSpan& operator=(ScopedSpan&& other) = delete;
+		ScopedSpan& operator=(const ScopedSpan& other) = delete;
+
+	private:
+		// the steady clock is the performance counter, like the game's own frame timing
+		static int64_t now() noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+	private:
+		Ring* m_ring;
+		const char* m_name;
+		const char* m_argName;
+		uint32_t m_arg;
+		int64_t m_start = 0;
+	};
+}
+
+#endif // ZFSERVER_TRACE_H
@@ -0,0 +1,218 @@
+//
+//  Copyright (c) CptSky <cptsky@me.com>
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the organization nor the names of its contributors
+//       may be used to endorse or promote products derived from this software
+//       without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "stats.h"
+
+#include "network/networkdef.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace zfserver;
+using namespace zfserver::network;
+
+namespace
+{
+	// the histogram of all the shards
+	struct Merged
+	{
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t max = 0;
+		uint64_t buckets[stats::BUCKET_COUNT] = {};
+
+		void add(const stats::Histogram& histogram) noexcept
+		{
+			count += histogram.count.load(std::memory_order_relaxed);
+			sum += histogram.sum.load(std::memory_order_relaxed);
+			max = std::max<uint64_t>(max, histogram.max.load(std::memory_order_relaxed));
+			for (size_t i = 0; i < stats::BUCKET_COUNT; ++i)
+				buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+		}
+
+		// the highest value of the bucket holding the percentile, like HdrHistogram
+		uint64_t percentile(double percent) const noexcept
+		{
+			const uint64_t rank = static_cast<uint64_t>(static_cast<double>(count) * percent / 100.0);
+
+			uint64_t seen = 0;
+			for (size_t i = 0; i < stats::BUCKET_COUNT; ++i)
+			{
+				seen += buckets[i];
+				if (seen > rank)
+					return i + 1 < stats::BUCKET_COUNT ? std::min(stats::lowestValueOf(i + 1) - 1, max) : max;
+			}
+			return max;
+		}
+	};
+
+	const char* probeName(size_t probe)
+	{
+		static constexpr const char* NAMES[stats::PROBE_COUNT] = { "processOutgoing", "recvFrom", "encrypt", "decrypt" };
+		return NAMES[probe];
+	}
+
+	const char* typeName(uint16_t type)
+	{
+		switch (type)
+		{
+		case MSG_TALK: return "MsgTalk";
+		case MSG_WALK: return "MsgWalk";
+		case MSG_USERINFO: return "MsgUserInfo";
+		case MSG_ITEM: return "MsgItem";
+		case MSG_ACTION: return "MsgAction";
+		case MSG_ACCOUNT: return "MsgAccount";
+		case MSG_CONNECT: return "MsgConnect";
+		case MSG_CONNECTEX: return "MsgConnectEx";
+		default: return "";
+		}
+	}
+
+	void printLatency(const char* name, uint16_t type, const Merged& merged)
+	{
+		if (merged.count == 0)
+			return;
+
+		std::printf("%-16s %5u %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n", name, type,
+			static_cast<unsigned long long>(merged.count),
+			static_cast<unsigned long long>(merged.sum / merged.count),
+			static_cast<unsigned long long>(merged.percentile(50.0)),
+			static_cast<unsigned long long>(merged.percentile(90.0)),
+			static_cast<unsigned long long>(merged.percentile(99.0)),
+			static_cast<unsigned long long>(merged.percentile(99.9)),
+			static_cast<unsigned long long>(merged.max));
+	}
+
+	void print(const stats::File& file)
+	{
+		const stats::Header& header = file.header;
+		const uint32_t usedShards = header.usedShards.load(std::memory_order_relaxed);
+		const uint32_t shardCount = std::min<uint32_t>(usedShards, header.shardCount);
+
+		const std::time_t start = static_cast<std::time_t>(header.startTime);
+		std::printf("Process %u, started %s", header.processId, std::ctime(&start));
+		std::printf("%u threads recording (%u ignored)\n\n", shardCount, usedShards - shardCount);
+
+		std::printf("%-16s %5s %10s %10s %10s %10s %10s %10s %10s\n", "latency (ns)", "type", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+		for (size_t probe = 0; probe < stats::PROBE_COUNT; ++probe)
+		{
+			Merged merged;
+			for (uint32_t i = 0; i < shardCount; ++i)
+				merged.add(file.shards[i].probes[probe]);
+			printLatency(probeName(probe), 0, merged);
+		}
+
+		// a handler runs on the game thread or on the server thread
+		for (size_t handler = 0; handler < stats::HANDLER_COUNT; ++handler)
+		{
+			Merged merged;
+			uint16_t type = 0;
+			for (uint32_t i = 0; i < shardCount; ++i)
+			{
+				merged.add(file.shards[i].handlers[handler].latency);
+				type = std::max(type, static_cast<uint16_t>(file.shards[i].handlers[handler].type.load(std::memory_order_relaxed)));
+			}
+			printLatency(typeName(type), type, merged);
+		}
+
+		std::printf("\n%-16s %5s %10s %10s %10s %10s\n", "messages", "type", "received", "bytes", "sent", "bytes");
+		for (size_t index = 0; index < stats::TYPE_COUNT; ++index)
+		{
+			uint64_t totals[stats::DIRECTION_COUNT][2] = {};
+			for (uint32_t i = 0; i < shardCount; ++i)
+			{
+				for (size_t direction = 0; direction < stats::DIRECTION_COUNT; ++direction)
+				{
+					const stats::Counter& counter = file.shards[i].types[direction][index];
+					totals[direction][0] += counter.count.load(std::memory_order_relaxed);
+					totals[direction][1] += counter.bytes.load(std::memory_order_relaxed);
+				}
+			}
+
+			if (totals[0][0] == 0 && totals[1][0] == 0)
+				continue;
+
+			const bool other = index == stats::TYPE_COUNT - 1;
+			const uint16_t type = other ? 0 : static_cast<uint16_t>(MSG_GENERAL + index);
+			std::printf("%-16s %5u %10llu %10llu %10llu %10llu\n", other ? "(other types)" : typeName(type), type,
+				static_cast<unsigned long long>(totals[0][0]), static_cast<unsigned long long>(totals[0][1]),
+				static_cast<unsigned long long>(totals[1][0]), static_cast<unsigned long long>(totals[1][1]));
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::printf("Usage: %s <zfserver_*.stats> [refresh seconds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const int refresh = argc >= 3 ? std::atoi(argv[2]) : 0;
+
+	// the game keeps writing, each read is a snapshot (the values are read whole, but not all at once)
+	auto file = std::make_unique<stats::File>();
+	for (;;)
+	{
+		FILE* stream = std::fopen(argv[1], "rb");
+		if (stream == nullptr)
+		{
+			std::printf("Failed to open '%s'.\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+
+		const size_t read = std::fread(reinterpret_cast<char*>(file.get()), 1, sizeof(stats::File), stream);
+		std::fclose(stream);
+
+		const stats::Header& header = file->header;
+		if (read != sizeof(stats::File) || header.magic != stats::FILE_MAGIC || header.version != stats::FILE_VERSION ||
+			header.shardCount != stats::SHARD_COUNT || header.probeCount != stats::PROBE_COUNT || header.typeCount != stats::TYPE_COUNT ||
+			header.handlerCount != stats::HANDLER_COUNT || header.bucketCount != stats::BUCKET_COUNT)
+		{
+			std::printf("'%s' is not a stats file (version %u).\n", argv[1], stats::FILE_VERSION);
+			return EXIT_FAILURE;
+		}
+
+		print(*file);
+		if (refresh <= 0)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::seconds(refresh));
+		std::printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}